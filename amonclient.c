@@ -0,0 +1,451 @@
+/**
+ * \file amonclient.c
+ * \brief Host client library, submits commands to a monitor asynchronously.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "amonclient.h"
+
+#define PROMPT	"> "	//!< The monitor's prompt, commands must not change it
+
+/**
+ * \brief A command waiting to be sent, or for its output
+ */
+typedef struct {
+	char cmd[AMON_CMD + 1];  //!< The command
+	amonDone_t done;  //!< Completion callback
+	void* arg;  //!< Argument for done
+} request_t;
+
+/**
+ * \brief Where the output being read belongs
+ */
+typedef enum {
+	SYNCING,  //!< Before the first prompt after our line end
+	ECHOING,  //!< The echo of a command, up to its line end
+	OUTPUT  //!< A command's output, up to the next prompt
+} state_t;
+
+/**
+ * \brief A connection to a monitor
+ */
+struct amonClient {
+	int fd;  //!< pty, serial device or socket
+	pid_t pid;  //!< Monitor started by amonSpawn(), or 0
+	char le;  //!< Line end the monitor expects
+	bool synced;  //!< The line end that finds the prompt has been queued
+	bool closed;  //!< The monitor has gone
+	unsigned window;  //!< Most commands sent and not completed
+	request_t q[AMON_QUEUE];  //!< Ring of requests
+	unsigned head;  //!< Oldest request, whose output is being read
+	unsigned len;  //!< Requests in the ring
+	unsigned sent;  //!< Requests from head that have been written
+	char out[AMON_QUEUE * (AMON_CMD + 1) + 1];  //!< Bytes waiting to be written
+	unsigned outLen;  //!< Bytes in out
+	state_t state;  //!< Parser state
+	char text[AMON_TEXT + 1];  //!< Output of the oldest request
+	unsigned textLen;  //!< Bytes in text
+};
+
+/**
+ * \brief Queue commands, up to the window, and write what the fd takes.
+ * \param c  The client
+ */
+static void flush(amonClient_t* c)
+{
+	if (!c->synced) {
+		c->out[c->outLen++] = c->le;
+		c->synced = true;
+	}
+	while ((c->state != SYNCING) && (c->sent < c->len) && (c->sent < c->window)) {
+		request_t* r = &c->q[(c->head + c->sent++) % AMON_QUEUE];
+		unsigned n = strlen(r->cmd);
+		memcpy(&c->out[c->outLen], r->cmd, n);
+		c->outLen += n;
+		c->out[c->outLen++] = c->le;
+	}
+	if (c->outLen > 0) {
+		// a socket mustn't raise SIGPIPE in the caller if the server has gone
+		int n = send(c->fd, c->out, c->outLen, MSG_NOSIGNAL);
+		if ((n < 0) && (errno == ENOTSOCK))
+			n = write(c->fd, c->out, c->outLen);
+		if (n > 0) {
+			memmove(c->out, &c->out[n], c->outLen - n);
+			c->outLen -= n;
+		}
+	}
+}
+
+/**
+ * \brief Complete the oldest request.
+ * \param c  The client
+ * \param type  Kind of result
+ * \param num  Value of an AMON_NUM
+ * \param text  Output, or an error's message
+ */
+static void complete(amonClient_t* c, amonType_t type, long long num, const char* text)
+{
+	request_t r = c->q[c->head];
+	amonResult_t res = { type, num, text, r.cmd };
+	c->head = (c->head + 1) % AMON_QUEUE;
+	c->len--;
+	c->sent--;
+	if (r.done != NULL)
+		r.done(&res, r.arg);
+}
+
+/**
+ * \brief Type a command's output and complete its request: the last line
+ * "# msg #" is an error, a single line that is all number is a number.
+ * \param c  The client, text holds the output without the prompt
+ */
+static void result(amonClient_t* c)
+{
+	char* s = c->text;
+	unsigned len = c->textLen;
+	if ((len > 0) && (s[len - 1] == '\n'))
+		len--;
+	s[len] = 0;
+	if (len == 0) {
+		complete(c, AMON_EMPTY, 0, s);
+		return;
+	}
+	char* last = strrchr(s, '\n');
+	last = (last == NULL) ? s : last + 1;
+	unsigned lastLen = s + len - last;
+	if ((lastLen >= 4) && !strncmp(last, "# ", 2) && !strcmp(last + lastLen - 2, " #")) {
+		last[lastLen - 2] = 0;
+		complete(c, AMON_ERR, 0, last + 2);
+		return;
+	}
+	char* end;
+	errno = 0;
+	long long n = (s[0] == '-') ? strtoll(s, &end, 0) : (long long)strtoull(s, &end, 0);
+	if ((*end == 0) && (end != s) && (errno == 0))
+		complete(c, AMON_NUM, n, s);
+	else
+		complete(c, AMON_STR, 0, s);
+}
+
+/**
+ * \brief Parse a character of the monitor's output.
+ * \param c  The client
+ * \param ch  The character
+ * \returns 1 if it completed a request, else 0
+ */
+static int parse(amonClient_t* c, char ch)
+{
+	if ((c->state == ECHOING) && (c->sent == 0))
+		return 0;  // nothing asked for, e.g. a watch
+	if (c->state == ECHOING) {
+		if (ch == '\n') {
+			c->state = OUTPUT;
+			c->textLen = 0;
+		}
+		return 0;
+	}
+	// keep the end of long output, it has the prompt and any error
+	if (c->textLen == AMON_TEXT)
+		memmove(c->text, c->text + 1, --c->textLen);
+	c->text[c->textLen++] = ch;
+	// a prompt at the start of a line ends the output
+	unsigned n = c->textLen;
+	if ((n < 2) || (c->text[n - 2] != PROMPT[0]) || (c->text[n - 1] != PROMPT[1]))
+		return 0;
+	if (c->state == SYNCING) {
+		if ((n >= 3) && (c->text[n - 3] == '\n'))
+			c->state = ECHOING;
+		return 0;
+	}
+	if ((n > 2) && (c->text[n - 3] != '\n'))
+		return 0;
+	c->textLen -= 2;
+	c->state = ECHOING;
+	result(c);
+	return 1;
+}
+
+/**
+ * \brief Make a client for a connected fd.
+ * \param fd  The connection
+ * \param pid  Monitor process, or 0
+ * \param window  Most commands in flight
+ * \returns The client, or NULL on failure
+ */
+static amonClient_t* start(int fd, pid_t pid, unsigned window)
+{
+	amonClient_t* c = calloc(1, sizeof(amonClient_t));
+	if (c == NULL) {
+		close(fd);
+		return NULL;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	c->fd = fd;
+	c->pid = pid;
+	c->le = '\n';
+	c->window = (window < 1) ? 1 : (window > AMON_QUEUE) ? AMON_QUEUE : window;
+	c->state = SYNCING;
+	return c;
+}
+
+/**
+ * \brief Put a tty in raw mode.
+ * \param fd  The tty
+ * \param speed  Baud rate constant, e.g. B115200, or 0 to leave it
+ */
+static void raw(int fd, speed_t speed)
+{
+	struct termios t;
+	if (tcgetattr(fd, &t) < 0)
+		return;
+	cfmakeraw(&t);
+	if (speed != 0)
+		cfsetspeed(&t, speed);
+	tcsetattr(fd, TCSANOW, &t);
+}
+
+/**
+ * \brief Connect to a monitor on a serial device, a pty (e.g. aMonLink's)
+ * or aMonServer's Unix socket.
+ * \param path  Device or socket
+ * \param baud  Baud rate for a serial device, 0 to leave it as it is
+ * \param window  Most commands sent before their output has arrived
+ * \returns The client, or NULL with errno set
+ */
+amonClient_t* amonOpen(const char* path, unsigned long baud, unsigned window)
+{
+	static const struct { unsigned long baud; speed_t speed; } speeds[] = {
+		{ 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+		{ 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 },
+	};
+	struct stat st;
+	int fd;
+
+	if ((stat(path, &st) == 0) && S_ISSOCK(st.st_mode)) {
+		struct sockaddr_un addr = { AF_UNIX };
+		strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if ((fd >= 0) && (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)) {
+			close(fd);
+			return NULL;
+		}
+	} else {
+		speed_t speed = 0;
+		for (int i=0; i<sizeof(speeds)/sizeof(speeds[0]); i++)
+			if (speeds[i].baud == baud)
+				speed = speeds[i].speed;
+		if ((baud != 0) && (speed == 0)) {
+			errno = EINVAL;
+			return NULL;
+		}
+		fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+		if (fd >= 0)
+			raw(fd, speed);
+	}
+	return (fd < 0) ? NULL : start(fd, 0, window);
+}
+
+/**
+ * \brief Start a monitor, e.g. the host build of aMon, on a pty.
+ * \param argv  Program and its arguments, NULL terminated
+ * \param window  Most commands sent before their output has arrived
+ * \returns The client, or NULL with errno set
+ */
+amonClient_t* amonSpawn(char* const argv[], unsigned window)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0))
+		return NULL;
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if (slave < 0) {
+		close(master);
+		return NULL;
+	}
+	// raw before the monitor starts so nothing is echoed or cooked
+	raw(slave, 0);
+	pid_t pid = fork();
+	if (pid == 0) {
+		setsid();
+		dup2(slave, STDIN_FILENO);
+		dup2(slave, STDOUT_FILENO);
+		close(slave);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	close(slave);
+	if (pid < 0) {
+		close(master);
+		return NULL;
+	}
+	return start(master, pid, window);
+}
+
+/**
+ * \brief Set the line end the monitor expects, '\\n' (the default) for a
+ * host build, '\\r' for a target. Call before amonSend().
+ * \param c  The client
+ * \param le  The line end
+ */
+void amonLineEnd(amonClient_t* c, char le)
+{
+	c->le = le;
+}
+
+/**
+ * \brief Submit a command. It is sent once fewer than the window's
+ * commands are in flight, its result goes to done from amonProcess().
+ * \param c  The client
+ * \param cmd  The command, at most AMON_CMD characters without line ends
+ * \param done  Completion callback, may be NULL
+ * \param arg  Argument for done
+ * \returns 0, or -1 if the queue is full, the command too long or the
+ * monitor has gone
+ */
+int amonSend(amonClient_t* c, const char* cmd, amonDone_t done, void* arg)
+{
+	if (c->closed || (c->len == AMON_QUEUE) || (strlen(cmd) > AMON_CMD) ||
+		strchr(cmd, '\n') || strchr(cmd, '\r'))
+		return -1;
+	request_t* r = &c->q[(c->head + c->len++) % AMON_QUEUE];
+	strcpy(r->cmd, cmd);
+	r->done = done;
+	r->arg = arg;
+	flush(c);
+	return 0;
+}
+
+/**
+ * \brief The fd to poll, with amonEvents(), before calling amonProcess().
+ * \param c  The client
+ * \returns The file descriptor
+ */
+int amonFd(amonClient_t* c)
+{
+	return c->fd;
+}
+
+/**
+ * \brief The poll events the client is waiting for.
+ * \param c  The client
+ * \returns POLLIN, with POLLOUT while commands are waiting to be written
+ */
+short amonEvents(amonClient_t* c)
+{
+	return (c->outLen > 0) ? POLLIN | POLLOUT : POLLIN;
+}
+
+/**
+ * \brief Read what the monitor has sent, call the callbacks of completed
+ * commands and send more. Doesn't block.
+ * \param c  The client
+ * \returns Commands completed, or -1 once the monitor has gone, when
+ * every outstanding command completes as an AMON_ERR "Closed"
+ */
+int amonProcess(amonClient_t* c)
+{
+	char buf[1024];
+	int n;
+	int done = 0;
+
+	if (c->closed)
+		return -1;
+	while ((n = read(c->fd, buf, sizeof(buf))) > 0)
+		for (int i=0; i<n; i++)
+			done += parse(c, buf[i]);
+	// a pty's master reads EIO once the monitor has exited
+	if ((n == 0) || ((errno != EAGAIN) && (errno != EINTR))) {
+		c->closed = true;
+		while (c->len > 0) {
+			c->sent++;
+			complete(c, AMON_ERR, 0, "Closed");
+		}
+		return -1;
+	}
+	flush(c);
+	return done;
+}
+
+/**
+ * \brief Wait for every submitted command to complete.
+ * \param c  The client
+ * \param timeoutMs  Longest wait, or -1 for no limit
+ * \returns 0, or -1 on timeout or if the monitor has gone
+ */
+int amonWait(amonClient_t* c, int timeoutMs)
+{
+	struct timespec t0, t;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (c->len > 0) {
+		int wait = -1;
+		if (timeoutMs >= 0) {
+			clock_gettime(CLOCK_MONOTONIC, &t);
+			wait = timeoutMs - (t.tv_sec - t0.tv_sec) * 1000 - (t.tv_nsec - t0.tv_nsec) / 1000000;
+			if (wait <= 0)
+				return -1;
+		}
+		struct pollfd pfd = { c->fd, amonEvents(c), 0 };
+		poll(&pfd, 1, wait);
+		if (amonProcess(c) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * \brief Commands submitted and not yet completed.
+ * \param c  The client
+ * \returns The number of commands
+ */
+unsigned amonPending(amonClient_t* c)
+{
+	return c->len;
+}
+
+/**
+ * \brief Disconnect, without calling the callbacks of outstanding
+ * commands. A monitor from amonSpawn() sees its input end and exits.
+ * \param c  The client
+ */
+void amonClose(amonClient_t* c)
+{
+	close(c->fd);
+	if (c->pid > 0)
+		waitpid(c->pid, NULL, 0);
+	free(c);
+}
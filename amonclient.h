@@ -0,0 +1,75 @@
+/**
+ * \file amonclient.h
+ * \brief Host client library, submits commands to a monitor asynchronously.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_AMONCLIENT_H)
+#define _AMONCLIENT_H
+
+#include <stdbool.h>
+
+#define AMON_QUEUE	64		//!< Commands waiting or in flight per client
+#define AMON_CMD	30		//!< Longest command, the monitor's input line
+#define AMON_TEXT	4096	//!< Longest output of a command that is kept
+
+/**
+ * \brief What a command returned
+ */
+typedef enum {
+	AMON_EMPTY,  //!< No output
+	AMON_NUM,  //!< A number, in num
+	AMON_STR,  //!< Other output, in text
+	AMON_ERR  //!< A "# ... #" error, the message is in text
+} amonType_t;
+
+/**
+ * \brief Result of a command, valid only during its callback
+ */
+typedef struct {
+	amonType_t type;  //!< Kind of result
+	long long num;  //!< Value of an AMON_NUM
+	const char* text;  //!< The output, or an error's message
+	const char* cmd;  //!< The command
+} amonResult_t;
+
+typedef struct amonClient amonClient_t;
+
+/**
+ * \brief Completion callback, called from amonProcess() in submission order
+ */
+typedef void (*amonDone_t)(const amonResult_t* r, void* arg);
+
+extern amonClient_t* amonOpen(const char* path, unsigned long baud, unsigned window);
+extern amonClient_t* amonSpawn(char* const argv[], unsigned window);
+extern void amonLineEnd(amonClient_t* c, char le);
+extern int amonSend(amonClient_t* c, const char* cmd, amonDone_t done, void* arg);
+extern int amonFd(amonClient_t* c);
+extern short amonEvents(amonClient_t* c);
+extern int amonProcess(amonClient_t* c);
+extern int amonWait(amonClient_t* c, int timeoutMs);
+extern unsigned amonPending(amonClient_t* c);
+extern void amonClose(amonClient_t* c);
+
+#endif
@@ -0,0 +1,226 @@
+/**
+ * \file capture.c
+ * \brief Sample a memory location into a buffer and read it out in bulk.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "capture.h"
+#include "context.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+#define FRAME_START	0x02	//!< First byte of a binary frame
+#define FRAME_TYPE	'C'		//!< Second byte, frame holds capture samples
+
+/**
+ * Called after each sample with the location sampled, main.h may set it
+ * to step a simulated peripheral. Nothing on a target.
+ */
+#if !defined(CAPTURE_STEP)
+#define CAPTURE_STEP(p)
+#endif
+
+static unum_t samples[CAPTURE_SIZE];
+static unsigned numSamples;  //!< Samples in the buffer
+static unsigned long capPeriod;  //!< Microseconds between samples
+static unsigned late;  //!< Samples taken a period or more late
+
+/**
+ * \brief Sample a location at a fixed rate into the capture buffer.
+ * Samples are not printed, 'readout' sends them afterwards.
+ * \param args  Array of 'NUM' tokens: address, a multiple of the size of
+ * a number, number of samples and microseconds between them (0 for as fast
+ * as possible)
+ * \param nArgs  Number of arguments, must be three
+ * \returns 'NUM' token containing the number of samples taken (must be freed)
+ * \note Clears then checks monCancel so a slow capture can be stopped.
+ */
+token_t* cmd_capture(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	unum_t addr = args[0]->v.d;
+	volatile unum_t* p = memAddr(addr, sizeof(unum_t));
+	num_t count = args[1]->v.d;
+	num_t period = args[2]->v.d;
+	token_t* r = tokenAlloc(ctx, "cmd_capture");
+
+	// a misaligned read of a whole number faults on many small parts
+	if ((p == NULL) || (addr & (sizeof(unum_t) - 1)) || (count < 1)
+			|| (count > CAPTURE_SIZE) || (period < 0)) {
+		emitError(ctx, r, MSG_ARGUMENT);
+		return r;
+	}
+
+	ctx->monCancel = false;
+	numSamples = 0;
+	capPeriod = period;
+	late = 0;
+	unsigned long next = clockMicros();
+	while ((numSamples < count) && !ctx->monCancel) {
+		if (capPeriod > 0) {
+			unsigned long now;
+			while ((long)((now = clockMicros()) - next) < 0)
+				;
+			if (now - next >= capPeriod)
+				late++;
+			next += capPeriod;
+		}
+		samples[numSamples++] = *p;
+		CAPTURE_STEP(p);
+	}
+	r->t = NUM;
+	r->v.d = numSamples;
+	return r;
+}
+
+/**
+ * \brief Add an item to a line of hex readout, sending the line when full.
+ * \param line  Line being built
+ * \param len  Length of line
+ * \param tag  Character before the number
+ * \param n  Number, in hex
+ */
+static void put(mon_ctx_t* ctx, char* line, unsigned* len, char tag, unum_t n)
+{
+	char buf[FORMAT_LEN];
+	char* s = formatHex(buf, n, false, 0);
+	unsigned l = FORMAT_END(buf) - s;
+	if (*len + l + 2 > CAPTURE_LINE) {
+		transmit(ctx, line, *len);
+		transmitString(ctx, EOL);
+		*len = 0;
+	} else if (*len > 0) {
+		line[(*len)++] = ' ';
+	}
+	line[(*len)++] = tag;
+	memcpy(&line[*len], s, l);
+	*len += l;
+}
+
+/**
+ * \brief Send the buffer as text. The first sample is sent as '=' and its
+ * value, each change from the previous sample as '+' or '-' and the
+ * difference, and '*' and a count repeats the last difference that many
+ * times (the difference starts as 0). Numbers are hex.
+ */
+static void readHex(mon_ctx_t* ctx)
+{
+	char line[CAPTURE_LINE];
+	unsigned len = 0;
+	unum_t delta = 0;
+	unsigned run = 0;
+
+	put(ctx, line, &len, '=', samples[0]);
+	for (unsigned i=1; i<numSamples; i++) {
+		unum_t d = samples[i] - samples[i-1];
+		if (d == delta) {
+			run++;
+			continue;
+		}
+		if (run > 0)
+			put(ctx, line, &len, '*', run);
+		run = 0;
+		delta = d;
+		if ((num_t)d < 0)
+			put(ctx, line, &len, '-', 0 - d);
+		else
+			put(ctx, line, &len, '+', d);
+	}
+	if (run > 0)
+		put(ctx, line, &len, '*', run);
+	transmit(ctx, line, len);
+	transmitString(ctx, EOL);
+}
+
+/**
+ * \brief Send the buffer as binary frames of up to CAPTURE_FRAME samples:
+ * FRAME_START, FRAME_TYPE, frame number, sample count, bytes per sample,
+ * the samples little endian, then a Fletcher-16 checksum of the bytes
+ * from the frame number on, low byte first. A line end follows the last.
+ */
+static void readBinary(mon_ctx_t* ctx)
+{
+	char frame[5 + CAPTURE_FRAME * sizeof(unum_t) + 2];
+	unsigned seq = 0;
+
+	for (unsigned i=0; i<numSamples; i+=CAPTURE_FRAME, seq++) {
+		unsigned n = (numSamples - i < CAPTURE_FRAME) ? numSamples - i : CAPTURE_FRAME;
+		unsigned len = 0;
+		frame[len++] = FRAME_START;
+		frame[len++] = FRAME_TYPE;
+		frame[len++] = seq;
+		frame[len++] = n;
+		frame[len++] = sizeof(unum_t);
+		for (unsigned j=0; j<n; j++) {
+			unum_t v = samples[i + j];
+			for (int b=0; b<sizeof(unum_t); b++, v >>= 8)
+				frame[len++] = v & 0xFF;
+		}
+		unsigned sum1 = 0, sum2 = 0;
+		for (unsigned j=2; j<len; j++) {
+			sum1 = (sum1 + (unsigned char)frame[j]) % 255;
+			sum2 = (sum2 + sum1) % 255;
+		}
+		frame[len++] = sum1;
+		frame[len++] = sum2;
+		transmit(ctx, frame, len);
+	}
+	transmitString(ctx, EOL);
+}
+
+/**
+ * \brief Send the capture buffer, after a summary line.
+ * \param args  Empty, or 'bin' for binary frames instead of hex text
+ * \param nArgs  Number of arguments, zero or one
+ * \returns 'EMPTY' token (must be freed)
+ */
+token_t* cmd_readout(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	bool binary = (nArgs == 1) && (args[0]->t == STR) && !strcmp(args[0]->v.s, "bin");
+	token_t* r = tokenAlloc(ctx, "cmd_readout");
+
+	if ((nArgs > 1) || ((nArgs == 1) && !binary)) {
+		emitError(ctx, r, MSG_ARGUMENT);
+		return r;
+	}
+	emitString(ctx, "samples ");
+	emitUnsigned(ctx, numSamples, 0);
+	emitString(ctx, ", period ");
+	emitUnsigned(ctx, capPeriod, 0);
+	emitString(ctx, " us, late ");
+	emitUnsigned(ctx, late, 0);
+	emitString(ctx, EOL);
+	if (numSamples > 0) {
+		if (binary)
+			readBinary(ctx);
+		else
+			readHex(ctx);
+	}
+	r->t = EMPTY;
+	return r;
+}
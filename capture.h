@@ -0,0 +1,40 @@
+/**
+ * \file capture.h
+ * \brief Sample a memory location into a buffer and read it out in bulk.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_CAPTURE_H)
+#define _CAPTURE_H
+
+#include "token.h"
+
+#define CAPTURE_SIZE	256	//!< Samples in the capture buffer
+#define CAPTURE_LINE	64	//!< Characters per line of hex readout
+#define CAPTURE_FRAME	32	//!< Samples per binary readout frame
+
+extern token_t* cmd_capture(mon_ctx_t* ctx, token_t *args[], int nArgs);
+extern token_t* cmd_readout(mon_ctx_t* ctx, token_t *args[], int nArgs);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * \file clienttest.c
+ * \brief Test of libamonclient against the host build of the monitor.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include "amonclient.h"
+
+/**
+ * \brief What a command should return
+ */
+typedef struct {
+	const char* cmd;  //!< Command
+	amonType_t type;  //!< Expected kind of result
+	long long num;  //!< Expected number
+	const char* text;  //!< Expected text, or NULL to not check it
+} expect_t;
+
+static const expect_t batch[] = {
+	{ "set a 5", AMON_EMPTY, 0, "" },
+	{ "get a", AMON_NUM, 5, "5" },
+	{ "add 2 3", AMON_NUM, 5, NULL },
+	{ "sub 2 3", AMON_NUM, -1, NULL },
+	{ "mul $a 7", AMON_NUM, 35, NULL },
+	{ "echo hello", AMON_STR, 0, "hello" },
+	{ "bogus", AMON_ERR, 0, "Command Not Found" },
+	{ "add 1", AMON_ERR, 0, "Argument Error" },
+	{ "echo !\"add 1 !$a\"", AMON_NUM, 6, NULL },
+	{ "hex", AMON_STR, 0, "output hexadecimal" },
+	{ "get a", AMON_NUM, 5, "0x5" },
+	{ "add 0xFF 1", AMON_NUM, 0x100, "0x100" },
+	{ "hex", AMON_STR, 0, "output decimal" },
+	{ "help", AMON_STR, 0, NULL },
+	{ "echo after help", AMON_STR, 0, "after\nhelp" },
+};
+#define BATCH	(sizeof(batch) / sizeof(batch[0]))
+
+static unsigned next = 0;  //!< Index of the result expected next
+static unsigned failures = 0;
+
+/**
+ * \brief Check a result against batch[], results must come in order.
+ */
+static void done(const amonResult_t* r, void* arg)
+{
+	const expect_t* e = arg;
+	if ((e != &batch[next]) || (r->type != e->type) ||
+		((e->type == AMON_NUM) && (r->num != e->num)) ||
+		((e->text != NULL) && strcmp(r->text, e->text))) {
+		printf("clienttest: '%s' gave %d %lld '%s'\n", e->cmd, r->type, r->num, r->text);
+		failures++;
+	}
+	next++;
+}
+
+/**
+ * \brief Check that exit's result is the monitor going.
+ */
+static void closed(const amonResult_t* r, void* arg)
+{
+	if ((r->type != AMON_ERR) || strcmp(r->text, "Closed")) {
+		printf("clienttest: exit gave %d '%s'\n", r->type, r->text);
+		failures++;
+	}
+}
+
+/**
+ * \brief Run batch[] through a monitor with a window of 4, first waiting
+ * with amonWait() and then with the caller's own poll() loop.
+ * \param argc  Argument count
+ * \param argv  The monitor to run and its arguments
+ * \returns 0 if every result was as expected
+ */
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: amonClientTest monitor [args]\n");
+		return 2;
+	}
+	for (int pass=0; pass<2; pass++) {
+		amonClient_t* c = amonSpawn(&argv[1], 4);
+		if (c == NULL) {
+			perror(argv[1]);
+			return 2;
+		}
+		next = 0;
+		for (unsigned i=0; i<BATCH; i++)
+			if (amonSend(c, batch[i].cmd, done, (void*)&batch[i]) < 0)
+				failures++;
+		if (pass == 0) {
+			if (amonWait(c, 5000) < 0)
+				failures++;
+		} else {
+			while (amonPending(c) > 0) {
+				struct pollfd pfd = { amonFd(c), amonEvents(c), 0 };
+				if ((poll(&pfd, 1, 5000) <= 0) || (amonProcess(c) < 0)) {
+					failures++;
+					break;
+				}
+			}
+		}
+		if (next != BATCH) {
+			printf("clienttest: %u of %u results\n", next, (unsigned)BATCH);
+			failures++;
+		}
+		// the monitor exits, outstanding commands fail
+		amonSend(c, "exit", closed, NULL);
+		if ((amonWait(c, 5000) == 0) || (amonSend(c, "get a", NULL, NULL) == 0))
+			failures++;
+		amonClose(c);
+	}
+	printf("clienttest: %s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
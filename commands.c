@@ -30,7 +30,39 @@
 
 #include "commands.h"
 #include "process.h"
+#include "monitor.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "pgm.h"
 #include "main.h"
+#ifdef INCL_WATCH
+#include "watch.h"
+#endif
+#ifdef INCL_MEMTEST
+#include "memtest.h"
+#endif
+#include "timecmd.h"
+#ifdef INCL_CAPTURE
+#include "capture.h"
+#endif
+#ifdef INCL_MEM
+#include "mem.h"
+#endif
+#ifdef INCL_CRC
+#include "crc.h"
+#endif
+#ifdef INCL_FIND
+#include "find.h"
+#endif
+#ifdef INCL_STACK
+#include "stack.h"
+#endif
+#ifdef INCL_STORE
+#include "store.h"
+#endif
+#include "prof.h"
+#include "trace.h"
 
 
 #if 0
@@ -40,18 +72,27 @@
 #define DEBUG(s)
 #endif
 
+#define CMD_NAME_LEN	10	//!< Longest command name plus one
+#define CMD_ARGS_LEN	6	//!< Longest argument codes plus one
+#define CMD_DOC_LEN		32	//!< Longest description plus one
+
 /**
- * \brief Command dispatch table element type
+ * \brief Command dispatch table element type. The strings are held in the
+ * element rather than pointed to, so the whole table stays in program
+ * memory and is read with pgm.h. With INCL_PACK the descriptions are
+ * packed with the messages (text.h) and the table has none.
  */
 typedef struct {
-    const char* name;  //!< Command string
-    token_t* (*func)(token_t**, int);  //!< Command function
-    const char* args;  /*!< Expected arguments encoded as a string containing the letters c for register name (character), s for string, d for number and + for repeat last character as needed. */
-    const char* doc;  //!< Description of command
+    char name[CMD_NAME_LEN];  //!< Command string
+    token_t* (*func)(mon_ctx_t*, token_t**, int);  //!< Command function
+    char args[CMD_ARGS_LEN];  /*!< Expected arguments encoded as a string containing the letters c for register name (character), s for string, d for number and + for repeat last character as needed. */
+#ifndef INCL_PACK
+    char doc[CMD_DOC_LEN];  //!< Description of command
+#endif
 } cmd_t;
 
 
-#define MK_CMD(x) static token_t* cmd_ ## x (token_t**, int)
+#define MK_CMD(x) static token_t* cmd_ ## x (mon_ctx_t*, token_t**, int)
 //Functions definitions
 MK_CMD(prompt);
 #ifdef INCL_REG
@@ -64,12 +105,20 @@ MK_CMD(sub);
 MK_CMD(mul);
 #endif
 MK_CMD(hex);
+MK_CMD(ansi);
 MK_CMD(echo);
 MK_CMD(help);
 
 //The dispatch table
+#if defined(TEXT_SCAN)
+// Only the help is wanted, by textpack
+#define CMD(func, params, help) TEXT_CMD help
+#elif defined(INCL_PACK)
+#define CMD(func, params, help) {#func, cmd_ ## func, params}
+#else
 #define CMD(func, params, help) {#func, cmd_ ## func, params, help}
-static cmd_t dsp_table[] ={
+#endif
+static const cmd_t dsp_table[] PGM_SPACE ={
     CMD(prompt, "s", "Select the prompt for input"),
 #ifdef INCL_REG
     CMD(set, "cs", "Set register to string"),
@@ -79,8 +128,51 @@ static cmd_t dsp_table[] ={
     CMD(add, "dd", "Add two numbers"),
     CMD(sub, "dd", "Subtract two numbers"),
     CMD(mul, "dd", "Multiply two numbers"),
+#endif
+#ifdef INCL_WATCH
+    CMD(watch, "ds", "Repeat command every d ms"),
+    CMD(unwatch, "d", "Stop repeating command"),
+#endif
+#ifdef INCL_TIME
+    CMD(time, "s+", "Time command, [runs] cmd"),
+#endif
+#ifdef INCL_MEMTEST
+    CMD(memtest, "dd+", "Test RAM, addr len [pattern]"),
+#ifdef BIG
+    CMD(memfault, "dd", "Inject stuck bit, addr bit"),
+#endif
+#endif
+#ifdef INCL_MEM
+    CMD(peek, "d+", "Read memory, addr [width]"),
+    CMD(poke, "dd+", "Write memory, addr val [width]"),
+    CMD(fill, "ddd", "Fill memory, addr len byte"),
+    CMD(copy, "ddd", "Copy memory, dst src len"),
+#endif
+#ifdef INCL_CRC
+    CMD(crc, "dd+", "Checksum, addr len [algo]"),
+#endif
+#ifdef INCL_FIND
+    CMD(find, "dd+", "Search, addr len pat [width]"),
+#endif
+#ifdef INCL_CAPTURE
+    CMD(capture, "ddd", "Sample addr, count period_us"),
+    CMD(readout, "+", "Send capture, [bin]"),
+#endif
+#ifdef INCL_STACK
+    CMD(stack, "", "Stack high water mark"),
+#endif
+#ifdef INCL_STORE
+    CMD(save, "", "Save registers & settings"),
+    CMD(restore, "", "Restore saved settings"),
+#endif
+#ifdef INCL_PROF
+    CMD(prof, "s", "Profile, start|stop|report"),
+#endif
+#ifdef INCL_TRACE
+    CMD(trace, "s", "Event trace, dump|clear"),
 #endif
     CMD(hex, "", "Toggle output base"),
+    CMD(ansi, "", "Toggle ANSI line editing"),
     CMD(echo, "s+", "Display parameter"),
     CMD(help, "", "Display this help")
 };
@@ -93,9 +185,10 @@ static cmd_t dsp_table[] ={
  * \param nArgs  Number of arguments
  * \returns token (must be freed)
  */
-static token_t* cmd_prompt(token_t *args[], int nArgs) {
-	strncpy(prompt, tokenGetText(args[0]), 20);
-	token_t* r = tokenAlloc("cmd_prompt");
+static token_t* cmd_prompt(mon_ctx_t* ctx, token_t *args[], int nArgs) {
+	char buf[FORMAT_LEN];
+	strncpy(ctx->prompt, tokenGetText(ctx, args[0], buf), PROMPT_LEN-1);
+	token_t* r = tokenAlloc(ctx, "cmd_prompt");
 	r->t = EMPTY;
     return r;
 }
@@ -107,10 +200,10 @@ static token_t* cmd_prompt(token_t *args[], int nArgs) {
  * \param nArgs  Number of arguments, must be two
  * \returns EMPTY token (must be freed)
  */
-static token_t* cmd_set(token_t *args[], int nArgs)
+static token_t* cmd_set(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
-	setReg(args[0]->v.c, args[1]);
-	token_t* r = tokenAlloc("cmd_set");
+	setReg(ctx, args[0]->v.c, args[1]);
+	token_t* r = tokenAlloc(ctx, "cmd_set");
 	r->t = EMPTY;
     return r;
 }
@@ -121,10 +214,10 @@ static token_t* cmd_set(token_t *args[], int nArgs)
  * \param nArgs  Number of arguments, must be one
  * \returns register contents in token (must be freed)
  */
-static token_t* cmd_get(token_t *args[], int nArgs)
+static token_t* cmd_get(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
-	token_t* r = getReg(args[0]->v.c);
-    return tokenDup(r, "cmd_get");
+	token_t* r = getReg(ctx, args[0]->v.c);
+    return tokenDup(ctx, r, "cmd_get");
 }
 #endif
 
@@ -135,11 +228,12 @@ static token_t* cmd_get(token_t *args[], int nArgs)
  * \param nArgs  Number of arguments, must be two
  * \returns 'NUM' token containing result (must be freed)
  */
-static token_t* cmd_add(token_t *args[], int nArgs)
+static token_t* cmd_add(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
-	token_t* r = tokenAlloc("cmd_add");
+	token_t* r = tokenAlloc(ctx, "cmd_add");
 	r->t = NUM;
-	r->v.d = args[0]->v.d + args[1]->v.d;
+	// unsigned so overflow wraps at NUM_BITS rather than being undefined
+	r->v.d = (num_t)((unum_t)args[0]->v.d + (unum_t)args[1]->v.d);
     return r;
 }
 
@@ -149,11 +243,11 @@ static token_t* cmd_add(token_t *args[], int nArgs)
  * \param nArgs  Number of arguments, must be two
  * \returns 'NUM' token containing result (must be freed)
  */
-static token_t* cmd_sub(token_t *args[], int nArgs)
+static token_t* cmd_sub(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
-	token_t* r = tokenAlloc("cmd_sub");
+	token_t* r = tokenAlloc(ctx, "cmd_sub");
 	r->t = NUM;
-	r->v.d = args[0]->v.d - args[1]->v.d;
+	r->v.d = (num_t)((unum_t)args[0]->v.d - (unum_t)args[1]->v.d);
     return r;
 }
 
@@ -163,11 +257,12 @@ static token_t* cmd_sub(token_t *args[], int nArgs)
  * \param nArgs  Number of arguments, must be two
  * \returns 'NUM' token containing result (must be freed)
  */
-static token_t* cmd_mul(token_t *args[], int nArgs)
+static token_t* cmd_mul(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
-	token_t* r = tokenAlloc("cmd_mul");
+	token_t* r = tokenAlloc(ctx, "cmd_mul");
 	r->t = NUM;
-	r->v.d = args[0]->v.d * args[1]->v.d;
+	// 1u * so 16 bit numbers multiply as unsigned int, not int which can overflow
+	r->v.d = (num_t)(unum_t)(1u * (unum_t)args[0]->v.d * (unum_t)args[1]->v.d);
     return r;
 }
 #endif
@@ -178,14 +273,33 @@ static token_t* cmd_mul(token_t *args[], int nArgs)
  * \param nArgs  Number of arguments, ignored
  * \returns 'EMPTY' token (must be freed)
  */
-static token_t* cmd_hex(token_t *args[], int nArgs)
+static token_t* cmd_hex(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	ctx->outputDecimal = !ctx->outputDecimal;
+	if (ctx->outputDecimal)
+		emitPgmString(ctx, "output decimal" EOL);
+	else
+		emitPgmString(ctx, "output hexadecimal" EOL);
+	token_t* r = tokenAlloc(ctx, "cmd_hex");
+	r->t = EMPTY;
+    return r;
+}
+
+/**
+ * \brief Toggle line editing between ANSI cursor control sequences and
+ * backspaces only, for dumb terminals
+ * \param args  Array of arguments in tokens, ignored
+ * \param nArgs  Number of arguments, ignored
+ * \returns 'EMPTY' token (must be freed)
+ */
+static token_t* cmd_ansi(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
-	outputDecimal = !outputDecimal;
-	if (outputDecimal)
-		transmitString("output decimal" EOL);
+	ctx->termAnsi = !ctx->termAnsi;
+	if (ctx->termAnsi)
+		emitPgmString(ctx, "terminal ansi" EOL);
 	else
-		transmitString("output hexadecimal" EOL);
-	token_t* r = tokenAlloc("cmd_hex");
+		emitPgmString(ctx, "terminal dumb" EOL);
+	token_t* r = tokenAlloc(ctx, "cmd_ansi");
 	r->t = EMPTY;
     return r;
 }
@@ -196,24 +310,30 @@ static token_t* cmd_hex(token_t *args[], int nArgs)
  * \param nArgs  Number of arguments, ignored
  * \returns token (must be freed)
  */
-static token_t* cmd_help(token_t *args[], int nArgs)
+static token_t* cmd_help(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
-    transmitString("Available Commands:" EOL);
+    emitPgmString(ctx, "Available Commands:" EOL);
     for (int i=0; i<CMDS; i++) {
-        cmd_t cmd = dsp_table[i];
-        for (int j=0; j<12-strlen(cmd.name)-strlen(cmd.args); j++)
-			transmitString(" ");
-        transmit((char*)cmd.name, strlen(cmd.name));
-		transmitString("(");
-        transmit((char*)cmd.args, strlen(cmd.args));
-		transmitString(") - ");
-        transmit((char*)cmd.doc, strlen(cmd.doc));
-		transmitString(EOL);
+        const cmd_t* cmd = &dsp_table[i];
+        unsigned name = pgmStrlen(cmd->name, CMD_NAME_LEN);
+        unsigned args = pgmStrlen(cmd->args, CMD_ARGS_LEN);
+        if (name + args < 12)
+            emitPad(ctx, 12 - name - args);
+        emitPgm(ctx, cmd->name, name);
+		emitString(ctx, "(");
+        emitPgm(ctx, cmd->args, args);
+		emitString(ctx, ") - ");
+#ifdef INCL_PACK
+        textEmit(ctx, MSG_COUNT + i);
+#else
+        emitPgm(ctx, cmd->doc, pgmStrlen(cmd->doc, CMD_DOC_LEN));
+#endif
+		emitString(ctx, EOL);
     }
 #ifdef INCL_EXIT
-		transmitString("        exit() - Exit monitor" EOL);
+		emitPgmString(ctx, "        exit() - Exit monitor" EOL);
 #endif
-	token_t* r = tokenAlloc("cmd_help");
+	token_t* r = tokenAlloc(ctx, "cmd_help");
 	r->t = EMPTY;
     return r;
 }
@@ -224,15 +344,14 @@ static token_t* cmd_help(token_t *args[], int nArgs)
  * \param nArgs  Number of arguments
  * \returns last argument token (must be freed)
  */
-static token_t* cmd_echo(token_t *args[], int nArgs)
+static token_t* cmd_echo(mon_ctx_t* ctx, token_t *args[], int nArgs)
 {
 	int i;
 	for (i=0; i<nArgs-1; i++) {
-		char *s = tokenGetText(args[i]);
-		transmitString(s);
-		transmitString(EOL);
+		emitToken(ctx, args[i]);
+		emitString(ctx, EOL);
 	}
-    return tokenDup(args[i], "cmd_echo");
+    return tokenDup(ctx, args[i], "cmd_echo");
 }
 
 /**
@@ -242,7 +361,7 @@ static token_t* cmd_echo(token_t *args[], int nArgs)
  * \param numTokens  Number of tokens
  * \returns The result as a token (must be freed)
  */
-token_t* command(token_t* tokens[], int numTokens)
+token_t* command(mon_ctx_t* ctx, token_t* tokens[], int numTokens)
 {
 	token_t* r;
 	int i;
@@ -253,7 +372,7 @@ token_t* command(token_t* tokens[], int numTokens)
 #endif
 
 	if (numTokens == 0) {
-		r = tokenAlloc("empty command");
+		r = tokenAlloc(ctx, "empty command");
 		r->t = EMPTY;
 		return r;
 	}
@@ -266,16 +385,19 @@ token_t* command(token_t* tokens[], int numTokens)
 	DEBUG(for (int i=0; i<numTokens; i++)
 			  tokenDebug("  arg", args[i]);)
 
-	char *cmdName = tokenGetText(cmd);
+	char buf[FORMAT_LEN];
+	char *cmdName = tokenGetText(ctx, cmd, buf);
 	DEBUG(printf("command name: %s\n", cmdName);)
 	for (i=0; i<CMDS; i++) {
-		cmd_t cur = dsp_table[i];
-		if (!strcmp(cmdName, cur.name)) {
+		if (!pgmStrcmp(cmdName, dsp_table[i].name, CMD_NAME_LEN)) {
+			cmd_t cur;
+			pgmCopy(&cur, &dsp_table[i], sizeof(cur));
+			TRACE(TRACE_COMMAND, i);
 			// Check arguments
 			bool argsOK = true;
 			int numChks = strlen(cur.args);
 			// last check of '+' means any number of extra arguments
-			if (cur.args[numChks-1] == '+') {
+			if ((numChks > 0) && (cur.args[numChks-1] == '+')) {
 				// don't check the '+', req more args than checks
 				numChks--;
 				if (numTokens < numChks)
@@ -317,21 +439,22 @@ token_t* command(token_t* tokens[], int numTokens)
 			DEBUG(printf("numChks %d, numTokens %d\n", numChks, numTokens);)
 			// Execute function?
 			if (argsOK) {
-				r = cur.func(args, numTokens);
+				TIME_BEGIN(ctx, t0);
+				PROF_COMMAND(dsp_table[i].name, c0);
+				PROF_ENTER(PROF_CMD, p0);
+				r = cur.func(ctx, args, numTokens);
+				PROF_LEAVE(p0);
+				PROF_COMMAND_END(c0);
+				TIME_END(ctx, handler, t0);
 			} else {
-				r = tokenAlloc("command");
-				r->t = ERR;
-				strcpy(r->v.s, "Argument Error");
-				transmitString("# Argument Error #" EOL);
+				r = emitError(ctx, tokenAlloc(ctx, "command"), MSG_ARGUMENT);
 			}
 			break;
 		}
 	}
 	if (i == CMDS) {
-		r = tokenAlloc("command");
-		r->t = ERR;
-		strcpy(r->v.s, "Command Not Found");
-		transmitString("# Command Not Found #" EOL);
+		TRACE(TRACE_COMMAND, 0xFFFF);
+		r = emitError(ctx, tokenAlloc(ctx, "command"), MSG_NOT_FOUND);
 	}
 
 	return r;
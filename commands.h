@@ -30,6 +30,6 @@
 
 #include "token.h"
 
-extern token_t* command(token_t* args[], int numTokens);
+extern token_t* command(mon_ctx_t* ctx, token_t* args[], int numTokens);
 
 #endif
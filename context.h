@@ -0,0 +1,101 @@
+/**
+ * \file context.h
+ * \brief State of one monitor session.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_CONTEXT_H)
+#define _CONTEXT_H
+
+#include <stdbool.h>
+
+#include "token.h"
+#include "lexer.h"
+#include "process.h"
+#include "timecmd.h"
+
+#define PROMPT_LEN	20	//!< Size of prompt including terminator
+
+/**
+ * History is a ring of entries packed as a length byte followed by the
+ * characters, oldest entries are dropped to make room for new ones.
+ * With the input line it uses the same RAM as the old four fixed lines.
+ */
+#define HIST_SIZE	(4 * MAX_STRING - MAX_STRING)
+
+/**
+ * \brief Monitor context, everything one session of the monitor needs.
+ * Sessions are independent so a host can serve many of them, the target
+ * has just one. Initialise with monInit().
+ */
+struct mon_ctx {
+	// monitor.c
+	char prompt[PROMPT_LEN];  //!< Prompt for input
+	bool monExit;  //!< Set by the exit command
+	volatile bool monCancel;  //!< Set (e.g. by the UART ISR on ^C) to stop a long running command
+	bool termAnsi;  //!< Console understands ANSI cursor control sequences
+	int escState;  //!< Progress through an escape sequence
+	char line[MAX_STRING];  //!< Input line
+	unsigned lineLen;  //!< Length of input line
+	unsigned cursor;  //!< Position of cursor in line
+#ifdef INCL_STREAM
+	token_t* lexed[MAX_ARGS];  //!< Tokens lexed from the line as it was typed
+	unsigned char lexedEnd[MAX_ARGS];  //!< Length of line lexed up to each
+	int numLexed;  //!< Number of lexed tokens
+	unsigned lexedTo;  //!< Length of line lexed
+#endif
+	char hist[HIST_SIZE];  //!< History ring
+	unsigned histTail;  //!< Oldest entry
+	unsigned histUsed;  //!< Bytes used by entries
+	unsigned histCount;  //!< Number of entries
+	unsigned histPos;  //!< Entry recalled, 1 is the newest, 0 none
+	bool searching;  //!< Reverse search in progress
+	char pat[MAX_STRING];  //!< Reverse search pattern
+	unsigned patLen;  //!< Length of reverse search pattern
+	unsigned found;  //!< Entry matching pat, as histPos
+	// token.c
+	bool outputDecimal;  //!< Numbers are output in decimal, otherwise hex
+	token_t pool[MAX_TOKENS];  //!< Tokens
+	bool inUse[MAX_TOKENS];  //!< Token is allocated
+	char* owners[MAX_TOKENS];  //!< Allocator of each token (for debugging)
+	// process.c
+	int evalDepth;  //!< Nesting of eval()
+	int evalMax;  //!< Deepest nesting of eval()
+#ifdef INCL_REG
+	token_t* regs[NUM_REGS];  //!< Registers
+#endif
+	// lexer.re2c
+	const char* lexStr;  //!< Next character to lex
+	int lexCond;  //!< re2c condition
+	int lexTop;  //!< Number of suspended lexers
+	const char* lexStrStk[LEX_DEPTH];  //!< Suspended lexers' lexStr
+	int lexCondStk[LEX_DEPTH];  //!< Suspended lexers' lexCond
+#ifdef INCL_TIME
+	// timecmd.c
+	timeStats_t time;  //!< Cost counters
+#endif
+	void* port;  //!< For the port, e.g. where transmit() sends output
+};
+
+#endif
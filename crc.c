@@ -0,0 +1,288 @@
+/**
+ * \file crc.c
+ * \brief Checksums of memory regions.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "crc.h"
+#include "context.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+#if CRC_KERNEL == CRC_ARM
+#include <arm_acle.h>
+#endif
+
+#define CRC32_POLY		0xEDB88320	//!< CRC-32 polynomial, bit reversed
+#define CRC16_POLY		0x1021		//!< CRC-16/CCITT polynomial
+#define FLETCHER_MAX	5802	//!< Bytes before a Fletcher-16 sum could overflow 32 bits
+#define ADLER_MAX		5552	//!< Bytes before an Adler-32 sum could overflow 32 bits
+#define ADLER_MOD		65521
+
+/**
+ * \brief A checksum: running state starts at 'init', is updated a chunk at
+ * a time and the result is the state exclusive or'd with 'xorOut'
+ */
+typedef struct {
+	const char* name;  //!< As given to the crc command
+	uint32_t (*update)(uint32_t sum, const uint8_t* p, unsigned long n);  //!< Sum more bytes
+	uint32_t init;  //!< Starting state
+	uint32_t xorOut;  //!< Applied to the final state
+} crcAlgo_t;
+
+static const crcAlgo_t algos[] = {
+	{ "crc32", crc32Update, 0xFFFFFFFF, 0xFFFFFFFF },
+	{ "crc16", crc16Update, 0xFFFF, 0 },
+	{ "fletcher", fletcher16Update, 0, 0 },
+	{ "adler", adler32Update, 1, 0 }
+};
+#define ALGOS	(sizeof(algos) / sizeof(crcAlgo_t))
+
+#if CRC_KERNEL == CRC_NIBBLE
+static const uint32_t crc32Nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+static const uint16_t crc16Nibble[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/**
+ * \brief CRC-32 of some bytes, a nibble at a time
+ * \param crc  Running CRC, not inverted
+ * \param p  Bytes
+ * \param n  Number of bytes
+ * \returns Running CRC
+ */
+uint32_t crc32Update(uint32_t crc, const uint8_t* p, unsigned long n)
+{
+	while (n--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ crc32Nibble[crc & 0xF];
+		crc = (crc >> 4) ^ crc32Nibble[crc & 0xF];
+	}
+	return crc;
+}
+
+/**
+ * \brief CRC-16/CCITT of some bytes, a nibble at a time
+ * \param crc  Running CRC
+ * \param p  Bytes
+ * \param n  Number of bytes
+ * \returns Running CRC
+ */
+uint32_t crc16Update(uint32_t crc, const uint8_t* p, unsigned long n)
+{
+	while (n--) {
+		crc ^= (uint32_t)*p++ << 8;
+		crc = ((crc << 4) & 0xFFFF) ^ crc16Nibble[(crc >> 12) & 0xF];
+		crc = ((crc << 4) & 0xFFFF) ^ crc16Nibble[(crc >> 12) & 0xF];
+	}
+	return crc;
+}
+
+#else
+static uint32_t crc32Table[8][256];  //!< Slice-by-8 tables, [0] is the byte table
+static uint16_t crc16Table[256];
+static bool tables = false;
+
+/**
+ * \brief Build the tables on first use rather than keep 9 KB of constants
+ */
+static void makeTables()
+{
+	for (unsigned i=0; i<256; i++) {
+		uint32_t c = i;
+		uint32_t d = i << 8;
+		for (int k=0; k<8; k++) {
+			c = (c & 1) ? (c >> 1) ^ CRC32_POLY : c >> 1;
+			d = (d & 0x8000) ? (d << 1) ^ CRC16_POLY : d << 1;
+		}
+		crc32Table[0][i] = c;
+		crc16Table[i] = d;
+	}
+	for (unsigned i=0; i<256; i++)
+		for (int t=1; t<8; t++)
+			crc32Table[t][i] = (crc32Table[t-1][i] >> 8) ^ crc32Table[0][crc32Table[t-1][i] & 0xFF];
+	tables = true;
+}
+
+/**
+ * \brief CRC-32 of some bytes, eight at a time with ARMv8 CRC32
+ * instructions or the slice-by-8 tables
+ * \param crc  Running CRC, not inverted
+ * \param p  Bytes
+ * \param n  Number of bytes
+ * \returns Running CRC
+ */
+uint32_t crc32Update(uint32_t crc, const uint8_t* p, unsigned long n)
+{
+#if CRC_KERNEL == CRC_ARM
+	for (; n >= 8; p += 8, n -= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		crc = __crc32d(crc, v);
+	}
+	while (n--)
+		crc = __crc32b(crc, *p++);
+#else
+	if (!tables)
+		makeTables();
+	for (; n >= 8; p += 8, n -= 8) {
+		// bytes in order whatever the CPU's endianness
+		uint32_t one = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+		uint32_t two = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+		crc = crc32Table[7][one & 0xFF] ^ crc32Table[6][(one >> 8) & 0xFF]
+			^ crc32Table[5][(one >> 16) & 0xFF] ^ crc32Table[4][one >> 24]
+			^ crc32Table[3][two & 0xFF] ^ crc32Table[2][(two >> 8) & 0xFF]
+			^ crc32Table[1][(two >> 16) & 0xFF] ^ crc32Table[0][two >> 24];
+	}
+	while (n--)
+		crc = (crc >> 8) ^ crc32Table[0][(crc ^ *p++) & 0xFF];
+#endif
+	return crc;
+}
+
+/**
+ * \brief CRC-16/CCITT of some bytes, a byte at a time
+ * \param crc  Running CRC
+ * \param p  Bytes
+ * \param n  Number of bytes
+ * \returns Running CRC
+ */
+uint32_t crc16Update(uint32_t crc, const uint8_t* p, unsigned long n)
+{
+	if (!tables)
+		makeTables();
+	while (n--)
+		crc = ((crc << 8) & 0xFFFF) ^ crc16Table[((crc >> 8) ^ *p++) & 0xFF];
+	return crc;
+}
+#endif
+
+/**
+ * \brief Fletcher-16 of some bytes, taking the modulus once per block
+ * \param sum  Running sums, the second in bits 8 to 15
+ * \param p  Bytes
+ * \param n  Number of bytes
+ * \returns Running sums
+ */
+uint32_t fletcher16Update(uint32_t sum, const uint8_t* p, unsigned long n)
+{
+	uint32_t a = sum & 0xFF, b = sum >> 8;
+	while (n > 0) {
+		unsigned long k = (n < FLETCHER_MAX) ? n : FLETCHER_MAX;
+		n -= k;
+		while (k--) {
+			a += *p++;
+			b += a;
+		}
+		a %= 255;
+		b %= 255;
+	}
+	return (b << 8) | a;
+}
+
+/**
+ * \brief Adler-32 of some bytes, taking the modulus once per block
+ * \param sum  Running sums, the second in the top 16 bits
+ * \param p  Bytes
+ * \param n  Number of bytes
+ * \returns Running sums
+ */
+uint32_t adler32Update(uint32_t sum, const uint8_t* p, unsigned long n)
+{
+	uint32_t a = sum & 0xFFFF, b = sum >> 16;
+	while (n > 0) {
+		unsigned long k = (n < ADLER_MAX) ? n : ADLER_MAX;
+		n -= k;
+		while (k--) {
+			a += *p++;
+			b += a;
+		}
+		a %= ADLER_MOD;
+		b %= ADLER_MOD;
+	}
+	return (b << 16) | a;
+}
+
+/**
+ * \brief Checksum a region of memory in place, e.g. to compare a flash
+ * image with the file it came from rather than reading it all out
+ * \param args  Array of tokens: 'NUM' address and length, and optionally
+ * the algorithm, crc32 (the default), crc16, fletcher or adler
+ * \param nArgs  Number of arguments, two or three
+ * \returns 'NUM' token containing the checksum (must be freed)
+ * \note Clears then checks monCancel so a long checksum can be stopped.
+ */
+token_t* cmd_crc(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	unum_t len = args[1]->v.d;
+	const uint8_t* p = memAddr((unum_t)args[0]->v.d, len);
+	const crcAlgo_t* algo = &algos[0];
+	token_t* r = tokenAlloc(ctx, "cmd_crc");
+
+	if (nArgs == 3) {
+		algo = NULL;
+		for (int i=0; (i<ALGOS) && (args[2]->t == STR); i++)
+			if (!strcmp(args[2]->v.s, algos[i].name))
+				algo = &algos[i];
+	}
+	if ((nArgs > 3) || (algo == NULL) || (p == NULL))
+		return emitError(ctx, r, MSG_ARGUMENT);
+
+	ctx->monCancel = false;
+	unsigned long t0 = clockMicros();
+	uint32_t sum = algo->init;
+	for (unum_t done = 0; done < len; ) {
+		unum_t k = len - done;
+		if (k > CRC_CHUNK)
+			k = CRC_CHUNK;
+		if (ctx->monCancel)
+			return emitError(ctx, r, MSG_CANCELLED);
+		sum = algo->update(sum, p + done, k);
+		done += k;
+	}
+	sum ^= algo->xorOut;
+	unsigned long t = clockMicros() - t0;
+
+	emitStr(ctx, algo->name, strlen(algo->name));
+	emitString(ctx, ": ");
+	emitUnsigned(ctx, len, 0);
+	emitString(ctx, " bytes, ");
+	emitRate(ctx, len, t);
+	emitString(ctx, " bytes/s" EOL);
+	if (sum > UNUM_MAX)
+		return emitError(ctx, r, MSG_RANGE);
+	r->t = NUM;
+	r->v.d = (num_t)(unum_t)sum;
+	return r;
+}
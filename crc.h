@@ -0,0 +1,59 @@
+/**
+ * \file crc.h
+ * \brief Checksums of memory regions.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_CRC_H)
+#define _CRC_H
+
+#include <stdint.h>
+
+#include "token.h"
+
+#define CRC_CHUNK		4096	//!< Bytes summed between checks for cancel
+
+#define CRC_NIBBLE		1		//!< 16 entry tables, 4 bits a step, for tiny parts
+#define CRC_SLICE8		2		//!< Eight 256 entry tables, 8 bytes a step
+#define CRC_ARM			3		//!< ARMv8 CRC32 instructions
+
+//! The CRC-32 kernel, a build may choose one with -DCRC_KERNEL=...
+#if !defined(CRC_KERNEL)
+#if defined(__ARM_FEATURE_CRC32)
+#define CRC_KERNEL		CRC_ARM
+#elif defined(BIG)
+#define CRC_KERNEL		CRC_SLICE8
+#else
+#define CRC_KERNEL		CRC_NIBBLE
+#endif
+#endif
+
+extern uint32_t crc32Update(uint32_t crc, const uint8_t* p, unsigned long n);
+extern uint32_t crc16Update(uint32_t crc, const uint8_t* p, unsigned long n);
+extern uint32_t fletcher16Update(uint32_t sum, const uint8_t* p, unsigned long n);
+extern uint32_t adler32Update(uint32_t sum, const uint8_t* p, unsigned long n);
+
+extern token_t* cmd_crc(mon_ctx_t* ctx, token_t *args[], int nArgs);
+
+#endif
@@ -0,0 +1,189 @@
+/**
+ * \file emit.c
+ * \brief Output straight to transmit(), without intermediate strings.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include "emit.h"
+#include "context.h"
+#include "print.h"
+#include "text.h"
+#include "main.h"
+
+#define PAD_CHUNK	16		//!< Spaces sent per transmit() by emitPad
+#define PGM_CHUNK	16		//!< Bytes copied out of program memory per transmit()
+
+/**
+ * \brief Send text whose length is known
+ * \param s  The text
+ * \param len  Its length
+ */
+void emitStr(mon_ctx_t* ctx, const char* s, unsigned len)
+{
+	transmit(ctx, (char*)s, len);
+}
+
+/**
+ * \brief Send spaces, a chunk at a time rather than one per transmit()
+ * \param n  Number of spaces
+ */
+void emitPad(mon_ctx_t* ctx, unsigned n)
+{
+	static const char spaces[PAD_CHUNK] = "                ";
+	while (n > 0) {
+		unsigned k = (n < PAD_CHUNK) ? n : PAD_CHUNK;
+		transmit(ctx, (char*)spaces, k);
+		n -= k;
+	}
+}
+
+/**
+ * \brief Send a number in the session's output base, as results are
+ * \param n  The number
+ */
+void emitNum(mon_ctx_t* ctx, num_t n)
+{
+	char buf[FORMAT_LEN];
+	char* p = formatNum(buf, n, ctx->outputDecimal);
+	transmit(ctx, p, FORMAT_END(buf) - p);
+}
+
+/**
+ * \brief Send a signed decimal number
+ * \param n  The number
+ * \param width  Minimum width, padded with leading spaces
+ */
+void emitDec(mon_ctx_t* ctx, num_t n, unsigned width)
+{
+	char buf[FORMAT_LEN];
+	char* p = formatDecimal(buf, n, width);
+	transmit(ctx, p, FORMAT_END(buf) - p);
+}
+
+/**
+ * \brief Send an unsigned decimal number
+ * \param n  The number
+ * \param width  Minimum width, padded with leading spaces
+ */
+void emitUnsigned(mon_ctx_t* ctx, unsigned long n, unsigned width)
+{
+	char buf[FORMAT_LEN];
+	char* p = formatUnsigned(buf, n, width);
+	transmit(ctx, p, FORMAT_END(buf) - p);
+}
+
+/**
+ * \brief Send a rate per second, worked out in 64 bits and clamped to what
+ * emitUnsigned() can show, as a long may be only 32 bits.
+ * \param n  Count, e.g. bytes
+ * \param us  Microseconds the count took
+ */
+void emitRate(mon_ctx_t* ctx, unsigned long long n, unsigned long us)
+{
+	unsigned long long rate = n * 1000000 / (us ? us : 1);
+	emitUnsigned(ctx, (rate > ULONG_MAX) ? ULONG_MAX : (unsigned long)rate, 0);
+}
+
+/**
+ * \brief Send a hexadecimal number
+ * \param n  The number
+ * \param prefix  Start with '0x'
+ * \param width  Minimum number of digits, padded with leading zeros
+ */
+void emitHex(mon_ctx_t* ctx, unum_t n, bool prefix, unsigned width)
+{
+	char buf[FORMAT_LEN];
+	char* p = formatHex(buf, n, prefix, width);
+	transmit(ctx, p, FORMAT_END(buf) - p);
+}
+
+/**
+ * \brief Send a token's value as text, as tokenGetText() gives it
+ * \param t  The token
+ */
+void emitToken(mon_ctx_t* ctx, token_t* t)
+{
+	if (t->t == STR)
+		transmit(ctx, t->v.s, strlen(t->v.s));
+	else if (t->t == NUM)
+		emitNum(ctx, t->v.d);
+#ifdef INCL_REG
+	else if (t->t == REG)
+		transmit(ctx, &t->v.c, 1);
+#endif
+}
+
+/**
+ * \brief Send text kept in program memory, through a buffer on the stack
+ * \param s  The text, in program memory
+ * \param len  Its length
+ */
+void emitPgm(mon_ctx_t* ctx, const char* s, unsigned len)
+{
+	char buf[PGM_CHUNK];
+	while (len > 0) {
+		unsigned k = (len < PGM_CHUNK) ? len : PGM_CHUNK;
+		pgmCopy(buf, s, k);
+		transmit(ctx, buf, k);
+		s += k;
+		len -= k;
+	}
+}
+
+/**
+ * \brief Start an error report, "# "
+ */
+void emitErrorOpen(mon_ctx_t* ctx)
+{
+	textEmit(ctx, MSG_OPEN);
+}
+
+/**
+ * \brief End an error report, " #" and a line end
+ */
+void emitErrorClose(mon_ctx_t* ctx)
+{
+	textEmit(ctx, MSG_CLOSE);
+	emitPgmString(ctx, EOL);
+}
+
+/**
+ * \brief Make a token an error and report it as "# message #"
+ * \param r  Token to set to the ERR
+ * \param msg  Error message number (MSG_*, text.h)
+ * \returns r
+ */
+token_t* emitError(mon_ctx_t* ctx, token_t* r, unsigned msg)
+{
+	r->t = ERR;
+	textCopy(r->v.s, msg, MAX_STRING);
+	emitErrorOpen(ctx);
+	transmit(ctx, r->v.s, strlen(r->v.s));
+	emitErrorClose(ctx);
+	return r;
+}
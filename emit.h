@@ -0,0 +1,54 @@
+/**
+ * \file emit.h
+ * \brief Output straight to transmit(), without intermediate strings.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_EMIT_H)
+#define _EMIT_H
+
+#include <stdbool.h>
+
+#include "token.h"
+#include "pgm.h"
+
+//! Send a string literal, its length known at compile time
+#define emitString(C, S)	emitStr(C, S, sizeof(S) - 1)
+//! Send a string literal kept in program memory
+#define emitPgmString(C, S)	emitPgm(C, PGM_STR(S), sizeof(S) - 1)
+
+extern void emitStr(mon_ctx_t* ctx, const char* s, unsigned len);
+extern void emitPad(mon_ctx_t* ctx, unsigned n);
+extern void emitNum(mon_ctx_t* ctx, num_t n);
+extern void emitDec(mon_ctx_t* ctx, num_t n, unsigned width);
+extern void emitUnsigned(mon_ctx_t* ctx, unsigned long n, unsigned width);
+extern void emitRate(mon_ctx_t* ctx, unsigned long long n, unsigned long us);
+extern void emitHex(mon_ctx_t* ctx, unum_t n, bool prefix, unsigned width);
+extern void emitToken(mon_ctx_t* ctx, token_t* t);
+extern void emitPgm(mon_ctx_t* ctx, const char* s, unsigned len);
+extern void emitErrorOpen(mon_ctx_t* ctx);
+extern void emitErrorClose(mon_ctx_t* ctx);
+extern token_t* emitError(mon_ctx_t* ctx, token_t* r, unsigned msg);
+
+#endif
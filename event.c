@@ -0,0 +1,114 @@
+/**
+ * \file event.c
+ * \brief Event loop, runs handlers for posted events and idles when there are none.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+
+#include "event.h"
+
+/**
+ * \brief Handler for one event source
+ */
+typedef struct {
+	eventFunc_t func;  //!< Called when the event is posted, NULL to ignore it
+	void* arg;  //!< Argument for func
+} handler_t;
+
+static handler_t handlers[EV_SOURCES];
+static handler_t idle;
+static volatile unsigned pending = 0;
+
+/**
+ * \brief Set the handler for an event source
+ * \param event  One of EV_INPUT, EV_TICK or EV_TX
+ * \param func  Function to call when the event is posted, NULL for none
+ * \param arg  Argument passed to func
+ */
+void eventOn(unsigned event, eventFunc_t func, void* arg)
+{
+	for (int i=0; i<EV_SOURCES; i++) {
+		if (event == (1u << i)) {
+			handlers[i].func = func;
+			handlers[i].arg = arg;
+		}
+	}
+}
+
+/**
+ * \brief Set the idle hook, called when no events are pending. It should
+ * sleep until one might be, e.g. WFI on a Cortex-M, poll() on a host.
+ * \note It is called with EVENT_LOCK() held so an interrupt can't post an
+ * event between the check and the sleep; WFI still wakes on an interrupt
+ * with interrupts masked. The hook must post with eventPostLocked(), as
+ * eventPost() would release the lock. Without a hook the loop spins.
+ * \param func  Idle function
+ * \param arg  Argument passed to func
+ */
+void eventIdle(eventFunc_t func, void* arg)
+{
+	idle.func = func;
+	idle.arg = arg;
+}
+
+/**
+ * \brief Post events, may be called from an interrupt.
+ * \param events  EV_ bits
+ */
+void eventPost(unsigned events)
+{
+	EVENT_LOCK();
+	pending |= events;
+	EVENT_UNLOCK();
+}
+
+/**
+ * \brief Post events with EVENT_LOCK() already held, e.g. from the idle hook.
+ * \param events  EV_ bits
+ */
+void eventPostLocked(unsigned events)
+{
+	pending |= events;
+}
+
+/**
+ * \brief Run the handlers of posted events, lowest bit first, and the
+ * idle hook whenever none are pending.
+ * \param stop  Return once a handler sets this, e.g. &ctx->monExit
+ */
+void eventRun(bool* stop)
+{
+	while (!*stop) {
+		EVENT_LOCK();
+		unsigned events = pending;
+		pending = 0;
+		if ((events == 0) && (idle.func != NULL))
+			idle.func(idle.arg);
+		EVENT_UNLOCK();
+		for (int i=0; (i<EV_SOURCES) && !*stop; i++)
+			if ((events & (1u << i)) && (handlers[i].func != NULL))
+				handlers[i].func(handlers[i].arg);
+	}
+}
@@ -0,0 +1,61 @@
+/**
+ * \file event.h
+ * \brief Event loop, runs handlers for posted events and idles when there are none.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_EVENT_H)
+#define _EVENT_H
+
+#include <stdbool.h>
+
+/**
+ * \brief Event sources, each a bit so they can be posted together
+ */
+#define EV_INPUT	0x01	//!< Input characters are waiting
+#define EV_TICK		0x02	//!< A timer tick, or ticks, have passed
+#define EV_TX		0x04	//!< Output has drained, more can be sent
+#define EV_SOURCES	3		//!< Number of event sources
+
+/**
+ * Guard the pending events against an interrupt posting one, e.g.
+ * __disable_irq() and __enable_irq(). Nothing is needed on a host.
+ */
+#if !defined(EVENT_LOCK)
+#define EVENT_LOCK()
+#define EVENT_UNLOCK()
+#endif
+
+/**
+ * \brief Event handler, or idle hook, called from eventRun()
+ */
+typedef void (*eventFunc_t)(void* arg);
+
+extern void eventOn(unsigned event, eventFunc_t func, void* arg);
+extern void eventIdle(eventFunc_t func, void* arg);
+extern void eventPost(unsigned events);
+extern void eventPostLocked(unsigned events);
+extern void eventRun(bool* stop);
+
+#endif
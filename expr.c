@@ -0,0 +1,277 @@
+/**
+ * \file expr.c
+ * \brief Infix expression evaluator.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "expr.h"
+#include "lexer.h"
+#include "process.h"
+#include "text.h"
+#include "main.h"
+
+/**
+ * \brief Operators, in the order of ops[]
+ */
+enum {
+	OPEN, NEG, NOT, LNOT, MUL, DIV, MOD, ADD, SUB, SHL, SHR,
+	LT, LE, GT, GE, EQ, NE, AND, XOR, OR, LAND, LOR
+};
+
+/**
+ * \brief Operator text and precedence, as in C. Binary operators are
+ * listed two character ones first so '<<' is found before '<'.
+ */
+static const struct {
+	char s[3];  //!< Text
+	char prec;  //!< Precedence, higher binds tighter
+} ops[] = {
+	{ "(", 0 }, { "-", 12 }, { "~", 12 }, { "!", 12 },
+	{ "*", 10 }, { "/", 10 }, { "%", 10 }, { "+", 9 }, { "-", 9 },
+	{ "<<", 8 }, { ">>", 8 }, { "<", 7 }, { "<=", 7 }, { ">", 7 }, { ">=", 7 },
+	{ "==", 6 }, { "!=", 6 }, { "&", 5 }, { "^", 4 }, { "|", 3 },
+	{ "&&", 2 }, { "||", 1 },
+};
+
+/**
+ * \brief Binary operators in the order to try them
+ */
+static const char binary[] = {
+	SHL, SHR, LE, GE, EQ, NE, LAND, LOR,
+	MUL, DIV, MOD, ADD, SUB, LT, GT, AND, XOR, OR
+};
+
+/**
+ * \brief Evaluator state, all on the stack of exprEval
+ */
+typedef struct {
+	num_t vals[EXPR_DEPTH];  //!< Operands
+	char ops[EXPR_DEPTH];  //!< Operators waiting for their right operand
+	int numVals;  //!< Operands on the stack
+	int numOps;  //!< Operators on the stack
+	int err;  //!< First error message (MSG_*), -1 if none
+} expr_t;
+
+/**
+ * \brief Apply the operator on top of the stack to its operands
+ * \param e  Evaluator state
+ */
+static void apply(expr_t* e)
+{
+	int op = e->ops[--e->numOps];
+	bool unary = (op == NEG) || (op == NOT) || (op == LNOT);
+	if (e->numVals < (unary ? 1 : 2)) {
+		e->err = MSG_EXPR;
+		return;
+	}
+	num_t b = e->vals[--e->numVals];
+	if (unary) {
+		e->vals[e->numVals++] = (op == NEG) ? (num_t)(0 - (unum_t)b)
+			: (op == NOT) ? (num_t)~(unum_t)b : !b;
+		return;
+	}
+	num_t a = e->vals[e->numVals - 1];
+	// unsigned so overflow wraps at NUM_BITS rather than being undefined,
+	// 1u * so 16 bit numbers promote to unsigned int rather than int
+	unum_t ua = a, ub = b;
+	num_t r;
+	switch (op) {
+	case MUL: r = (unum_t)(1u * ua * ub); break;
+	case DIV:
+	case MOD:
+		if (b == 0) {
+			e->err = MSG_DIV_ZERO;
+			return;
+		}
+		if (b == -1)	// NUM_MIN / -1 overflows
+			r = (op == DIV) ? 0 - ua : 0;
+		else
+			r = (op == DIV) ? a / b : a % b;
+		break;
+	case ADD: r = ua + ub; break;
+	case SUB: r = ua - ub; break;
+	case SHL: r = (ub >= NUM_BITS) ? 0 : (unum_t)(1u * ua << ub); break;
+	case SHR:	// arithmetic, the sign is kept
+		if (ub >= NUM_BITS)
+			r = (a < 0) ? -1 : 0;
+		else
+			r = (a < 0) ? ~((unum_t)~ua >> ub) : ua >> ub;
+		break;
+	case LT: r = a < b; break;
+	case LE: r = a <= b; break;
+	case GT: r = a > b; break;
+	case GE: r = a >= b; break;
+	case EQ: r = a == b; break;
+	case NE: r = a != b; break;
+	case AND: r = ua & ub; break;
+	case XOR: r = ua ^ ub; break;
+	case OR: r = ua | ub; break;
+	case LAND: r = a && b; break;
+	default: r = a || b; break;
+	}
+	e->vals[e->numVals - 1] = r;
+}
+
+/**
+ * \brief Push an operator, first applying those that bind at least as
+ * tightly (unary ones are right associative so wait for their operand).
+ * \param e  Evaluator state
+ * \param op  Operator
+ */
+static void push(expr_t* e, int op)
+{
+	if ((op != OPEN) && (ops[op].prec < 12))
+		while ((e->numOps > 0) && (ops[(int)e->ops[e->numOps - 1]].prec >= ops[op].prec)
+			   && (e->err < 0))
+			apply(e);
+	if (e->numOps == EXPR_DEPTH)
+		e->err = MSG_EXPR_DEEP;
+	else
+		e->ops[e->numOps++] = op;
+}
+
+/**
+ * \brief Read an operand
+ * \param ctx  Monitor context, for registers
+ * \param e  Evaluator state
+ * \param s  Text
+ * \returns Text after the operand
+ */
+static const char* operand(mon_ctx_t* ctx, expr_t* e, const char* s)
+{
+	const char* q = s;
+	num_t n = 0;
+
+	if ((s[0] == '0') && ((s[1] | 0x20) == 'x')) {
+		for (q = s += 2; ((*s >= '0') && (*s <= '9')) || (((*s | 0x20) >= 'a') && ((*s | 0x20) <= 'f')); s++)
+			;
+		if (s == q)
+			e->err = MSG_EXPR;
+		else if (!lexNumber(q, s, 16, false, &n))
+			e->err = MSG_RANGE;
+	} else if ((*s >= '0') && (*s <= '9')) {
+		while ((*s >= '0') && (*s <= '9'))
+			s++;
+		if (!lexNumber(q, s, 10, false, &n))
+			e->err = MSG_RANGE;
+#ifdef INCL_REG
+	} else if (*s == '$') {
+		// getReg reports a register that is out of range or undefined
+		token_t* t = getReg(ctx, s[1]);
+		if (t->t != NUM)
+			e->err = MSG_EXPR;
+		n = t->v.d;
+		s += 2;
+#endif
+	} else {
+		e->err = MSG_EXPR;
+	}
+	if (e->err < 0) {
+		if (e->numVals == EXPR_DEPTH)
+			e->err = MSG_EXPR_DEEP;
+		else
+			e->vals[e->numVals++] = n;
+	}
+	return s;
+}
+
+/**
+ * \brief Evaluate an infix expression of numbers, registers, parentheses
+ * and C's arithmetic, shift, bitwise, comparison and logical operators,
+ * by shunting-yard with fixed stacks. No tokens are allocated.
+ * \param ctx  Monitor context, for registers
+ * \param s  The expression, e.g. "($a + 3) * 2 & 0xFF"
+ * \param result  Set to the NUM, or to an ERR with the reason
+ */
+void exprEval(mon_ctx_t* ctx, const char* s, token_t* result)
+{
+	expr_t e;
+	bool wantOperand = true;
+
+	e.numVals = 0;
+	e.numOps = 0;
+	e.err = -1;
+	while (e.err < 0) {
+		while ((*s == ' ') || (*s == '\t'))
+			s++;
+		if (wantOperand) {
+			if (*s == '(')
+				push(&e, OPEN);
+			else if (*s == '-')
+				push(&e, NEG);
+			else if (*s == '~')
+				push(&e, NOT);
+			else if (*s == '!')
+				push(&e, LNOT);
+			else {
+				s = operand(ctx, &e, s);
+				wantOperand = false;
+				continue;
+			}
+			s++;
+		} else if (*s == ')') {
+			while ((e.numOps > 0) && (e.ops[e.numOps - 1] != OPEN) && (e.err < 0))
+				apply(&e);
+			if (e.numOps == 0)
+				e.err = MSG_EXPR;
+			else
+				e.numOps--;
+			s++;
+		} else if (*s == 0) {
+			while ((e.numOps > 0) && (e.err < 0)) {
+				if (e.ops[e.numOps - 1] == OPEN)
+					e.err = MSG_EXPR;
+				else
+					apply(&e);
+			}
+			break;
+		} else {
+			int i;
+			for (i=0; i<sizeof(binary); i++) {
+				const char* o = ops[(int)binary[i]].s;
+				if ((s[0] == o[0]) && ((o[1] == 0) || (s[1] == o[1])))
+					break;
+			}
+			if (i == sizeof(binary)) {
+				e.err = MSG_EXPR;
+			} else {
+				push(&e, binary[i]);
+				s += strlen(ops[(int)binary[i]].s);
+				wantOperand = true;
+			}
+		}
+	}
+	if ((e.err < 0) && (e.numVals != 1))
+		e.err = MSG_EXPR;
+	if (e.err >= 0) {
+		result->t = ERR;
+		textCopy(result->v.s, e.err, MAX_STRING);
+	} else {
+		result->t = NUM;
+		result->v.d = e.vals[0];
+	}
+}
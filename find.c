@@ -0,0 +1,185 @@
+/**
+ * \file find.c
+ * \brief Search memory for a string or word.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "find.h"
+#include "context.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+/**
+ * \brief Find a short string, memchr() for its first byte then compare
+ * \param p  Memory
+ * \param n  Bytes of memory
+ * \param pat  String
+ * \param m  Length of the string, at least one
+ * \returns Offset of the first match, or -1
+ */
+static long findShort(const uint8_t* p, unum_t n, const uint8_t* pat, unsigned m)
+{
+	const uint8_t* q = p;
+	const uint8_t* end = p + n - m + 1;
+	while ((q < end) && ((q = memchr(q, pat[0], end - q)) != NULL)) {
+		if (!memcmp(q + 1, pat + 1, m - 1))
+			return q - p;
+		q++;
+	}
+	return -1;
+}
+
+/**
+ * \brief Find a longer string with Boyer-Moore-Horspool: compare the last
+ * byte of the window and, on a mismatch, skip as far as the byte there
+ * allows
+ * \param p  Memory
+ * \param n  Bytes of memory
+ * \param pat  String
+ * \param m  Length of the string, less than MAX_STRING
+ * \returns Offset of the first match, or -1
+ */
+static long findHorspool(const uint8_t* p, unum_t n, const uint8_t* pat, unsigned m)
+{
+	unsigned char skip[256];
+	memset(skip, m, sizeof(skip));
+	for (unsigned i=0; i+1<m; i++)
+		skip[pat[i]] = m - 1 - i;
+	uint8_t last = pat[m - 1];
+	for (unum_t i=0; i+m<=n; i+=skip[p[i + m - 1]])
+		if ((p[i + m - 1] == last) && !memcmp(p + i, pat, m - 1))
+			return i;
+	return -1;
+}
+
+/**
+ * \brief Find an aligned word
+ * \param p  First word
+ * \param n  Number of words
+ * \param v  Value
+ * \param width  Bytes in a word, 1, 2, 4 or 8
+ * \returns Index of the first match, or -1
+ */
+static long findWord(const void* p, unum_t n, unum_t v, int width)
+{
+	if (width == 1) {
+		const uint8_t* q = memchr(p, v, n);
+		return (q != NULL) ? q - (const uint8_t*)p : -1;
+	}
+	if (width == 2) {
+		const uint16_t* w = p;
+		for (unum_t i=0; i<n; i++)
+			if (w[i] == v)
+				return i;
+	}
+#if NUM_BITS >= 32
+	else if (width == 4) {
+		const uint32_t* w = p;
+		for (unum_t i=0; i<n; i++)
+			if (w[i] == v)
+				return i;
+	}
+#endif
+#if NUM_BITS >= 64
+	else {
+		const uint64_t* w = p;
+		for (unum_t i=0; i<n; i++)
+			if (w[i] == v)
+				return i;
+	}
+#endif
+	return -1;
+}
+
+/**
+ * \brief Search memory for a string or an aligned word and print the
+ * address of each match, up to FIND_MAX of them
+ * \param args  Array of tokens: 'NUM' address and length, then the
+ * pattern, a string of bytes, or a 'NUM' word with an optional width of
+ * 1, 2, 4 or 8 bytes (default the size of a number) found only at
+ * addresses that are multiples of the width
+ * \param nArgs  Number of arguments, three or four
+ * \returns 'NUM' token containing the number of matches (must be freed)
+ * \note Clears then checks monCancel so a long search can be stopped.
+ */
+token_t* cmd_find(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	unum_t addr = args[0]->v.d;
+	unum_t len = args[1]->v.d;
+	token_t* pattern = args[2];
+	bool word = (pattern->t == NUM);
+	int width = (nArgs > 3) ? args[3]->v.d : (int)sizeof(unum_t);
+	unsigned m = word ? width : strlen(pattern->v.s);
+	token_t* r = tokenAlloc(ctx, "cmd_find");
+
+	if (word) {
+		// search the aligned words inside the region
+		unum_t skip = (width - (addr & (width - 1))) & (width - 1);
+		addr += skip;
+		len = (len > skip) ? (len - skip) & ~(unum_t)(width - 1) : 0;
+	}
+	const uint8_t* p = memAddr(addr, len);
+	if ((nArgs > 4) || ((nArgs == 4) && (!word || (args[3]->t != NUM)))
+		|| (!word && (pattern->t != STR)) || (m == 0) || (p == NULL))
+		return emitError(ctx, r, MSG_ARGUMENT);
+	if (word && ((width != 1) && (width != 2) && (width != 4) && (width != 8)))
+		return emitError(ctx, r, MSG_ARGUMENT);
+	if (word && ((width > sizeof(unum_t))
+				 || ((width < sizeof(unum_t)) && ((unum_t)pattern->v.d >> (width * 8)))))
+		return emitError(ctx, r, MSG_ARGUMENT);
+
+	ctx->monCancel = false;
+	unsigned found = 0;
+	unum_t at = 0;
+	while ((found < FIND_MAX) && (at + m <= len)) {
+		if (ctx->monCancel)
+			return emitError(ctx, r, MSG_CANCELLED);
+		unum_t span = len - at;
+		if (span > FIND_CHUNK + m - 1)
+			span = FIND_CHUNK + m - 1;
+		long i;
+		if (word)
+			i = findWord(p + at, span / width, pattern->v.d, width) * width;
+		else if (m < FIND_HORSPOOL)
+			i = findShort(p + at, span, (const uint8_t*)pattern->v.s, m);
+		else
+			i = findHorspool(p + at, span, (const uint8_t*)pattern->v.s, m);
+		if (i < 0) {
+			at += span - m + 1;
+			continue;
+		}
+		emitHex(ctx, addr + at + i, true, 8);
+		emitString(ctx, EOL);
+		found++;
+		at += i + (word ? width : 1);
+	}
+	r->t = NUM;
+	r->v.d = found;
+	return r;
+}
@@ -0,0 +1,339 @@
+/**
+ * \file host.c
+ * \brief Services the monitor needs from a Unix host.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "host.h"
+#include "timer.h"
+#ifdef INCL_STACK
+#include "stack.h"
+#endif
+#include "store.h"
+#include "prof.h"
+#include "pgm.h"
+#include "main.h"
+
+static unsigned char* simMem;
+static unsigned char* fileMem;
+static unsigned long fileSize;
+#define FLASH_SIZE	(STORE_PAGES * STORE_PAGE_SIZE)
+
+static unsigned char* flash;  //!< Store pages, NULL if there is no store
+static unsigned long tickTime;  //!< clockMicros() of the last tick counted
+unsigned long pgmReads;  //!< Stand-in flash accesses, counted by pgm.h
+
+/**
+ * \brief Read a free running microsecond clock.
+ * \returns Microseconds, wraps around.
+ */
+unsigned long clockMicros()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+/**
+ * \brief Translate a monitor address to a pointer. On a target this is
+ * just a cast, here addresses select part of an mmap'd region.
+ * \param addr  Monitor address.
+ * \param len  Number of bytes that will be accessed.
+ * \returns Pointer, or NULL if the range is not simulated.
+ */
+void* memAddr(unsigned long addr, unsigned long len)
+{
+	if ((fileMem != NULL) && (addr >= SIM_FILE_BASE)) {
+		addr -= SIM_FILE_BASE;
+		if ((addr >= fileSize) || (len > fileSize - addr))
+			return NULL;
+		return fileMem + addr;
+	}
+	if ((simMem == NULL) || (addr >= SIM_MEM_SIZE) || (len > SIM_MEM_SIZE - addr))
+		return NULL;
+	return simMem + addr;
+}
+
+/**
+ * \brief Step the simulated sensor after capture samples it, so capture
+ * and readout can be tested on data that changes. It rises, jumps, falls,
+ * holds and returns to where it started every ten samples, then holds the
+ * CPU for SENSOR_STALL_US, as a long interrupt would, so with a shorter
+ * capture period the next sample is late.
+ * \param p  Location sampled, other locations are left alone.
+ */
+void hostCaptureStep(const volatile void* p)
+{
+	static const signed char steps[] = { 1, 1, 1, 4, -2, -2, 0, 0, 0, -3 };
+	static unsigned n = 0;
+	volatile uint16_t* s = memAddr(SIM_SENSOR, sizeof(uint16_t));
+
+	if ((s == NULL) || (p != s))
+		return;
+	*s += steps[n];
+	if (++n == sizeof(steps)) {
+		n = 0;
+		unsigned long t0 = clockMicros();
+		while (clockMicros() - t0 < SENSOR_STALL_US)
+			;
+	}
+}
+
+/**
+ * \brief Map the simulated memory, every session shares it.
+ */
+void hostMemInit()
+{
+	simMem = mmap(NULL, SIM_MEM_SIZE, PROT_READ | PROT_WRITE,
+				  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (simMem == MAP_FAILED)
+		simMem = NULL;
+}
+
+/**
+ * \brief Put the simulated memory in a POSIX shared memory object,
+ * created if need be, so a simulator can attach to it.
+ * \param name  Object name, e.g. "/aMon"
+ * \returns false if it can't be mapped
+ */
+bool hostMemShare(const char* name)
+{
+	int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd < 0)
+		return false;
+	if (ftruncate(fd, SIM_MEM_SIZE) < 0) {
+		close(fd);
+		return false;
+	}
+	void* p = mmap(NULL, SIM_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	if (simMem != NULL)
+		munmap(simMem, SIM_MEM_SIZE);
+	simMem = p;
+	return true;
+}
+
+/**
+ * \brief Map a file at SIM_FILE_BASE, shared so that another process
+ * writing the file, e.g. simulating a peripheral, changes what the
+ * monitor reads.
+ * \param path  File name
+ * \returns false if the file can't be mapped
+ */
+bool hostMapFile(const char* path)
+{
+	struct stat st;
+	int fd = open(path, O_RDWR);
+	if (fd < 0)
+		return false;
+	if ((fstat(fd, &st) < 0) || (st.st_size == 0)) {
+		close(fd);
+		return false;
+	}
+	void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	fileMem = p;
+	fileSize = st.st_size;
+	return true;
+}
+
+/**
+ * \brief Keep the store's flash pages in a file, created erased if it is
+ * new, so settings saved by one session are restored by the next.
+ * \param path  File name
+ * \returns false if the file can't be created or mapped
+ */
+bool hostStoreFile(const char* path)
+{
+	struct stat st;
+	int fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return false;
+	}
+	if (st.st_size != FLASH_SIZE) {
+		unsigned char erased[STORE_PAGE_SIZE];
+		memset(erased, 0xFF, sizeof(erased));
+		bool ok = ftruncate(fd, 0) == 0;
+		for (int i=0; ok && (i<STORE_PAGES); i++)
+			ok = write(fd, erased, sizeof(erased)) == sizeof(erased);
+		if (!ok) {
+			close(fd);
+			return false;
+		}
+	}
+	void* p = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	flash = p;
+	return true;
+}
+
+/**
+ * \brief Page of the store file
+ * \param page  Page number
+ * \returns The page, or NULL if there is no store
+ */
+const unsigned char* flashPage(unsigned page)
+{
+	return ((flash == NULL) || (page >= STORE_PAGES)) ? NULL : &flash[page * STORE_PAGE_SIZE];
+}
+
+/**
+ * \brief Program bytes of a page, clearing bits only as flash does.
+ * \param page  Page number
+ * \param offset  Offset in the page, a multiple of STORE_ALIGN
+ * \param p  Bytes to write
+ * \param len  Number of bytes, a multiple of STORE_ALIGN
+ * \returns false if the write is outside the page or misaligned
+ */
+bool flashWrite(unsigned page, unsigned offset, const void* p, unsigned len)
+{
+	if ((flash == NULL) || (page >= STORE_PAGES) || (offset > STORE_PAGE_SIZE) ||
+		(len > STORE_PAGE_SIZE - offset) || ((offset | len) % STORE_ALIGN != 0))
+		return false;
+	unsigned char* d = &flash[page * STORE_PAGE_SIZE + offset];
+	const unsigned char* s = p;
+	while (len--)
+		*d++ &= *s++;
+	return true;
+}
+
+/**
+ * \brief Erase a page to 0xFF
+ * \param page  Page number
+ * \returns false if there is no such page
+ */
+bool flashErase(unsigned page)
+{
+	if ((flash == NULL) || (page >= STORE_PAGES))
+		return false;
+	memset(&flash[page * STORE_PAGE_SIZE], 0xFF, STORE_PAGE_SIZE);
+	return true;
+}
+
+/**
+ * \brief SIGPROF handler, takes a profiler sample
+ * \param sig  SIGPROF
+ */
+static void profSignal(int sig)
+{
+	profSample();
+}
+
+/**
+ * \brief Sample with SIGPROF, which counts the CPU time the monitor uses,
+ * so time asleep waiting for input isn't sampled.
+ * \param us  Sample period, 0 to stop
+ * \returns false if the timer can't be set
+ */
+bool profTimer(unsigned long us)
+{
+	struct sigaction sa;
+	struct itimerval it;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = profSignal;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if ((us != 0) && (sigaction(SIGPROF, &sa, NULL) < 0))
+		return false;
+	it.it_interval.tv_sec = it.it_value.tv_sec = us / 1000000;
+	it.it_interval.tv_usec = it.it_value.tv_usec = us % 1000000;
+	return setitimer(ITIMER_PROF, &it, NULL) == 0;
+}
+
+/**
+ * \brief Start counting TIMER_TICK_MS ticks from now.
+ */
+void hostTickStart()
+{
+	tickTime = clockMicros();
+}
+
+/**
+ * \brief How long the host can sleep before a timer is due, rather than
+ * waking every tick.
+ * \returns Milliseconds, rounded up, for a poll() or epoll_wait() timeout,
+ * or -1 if no timer is running
+ */
+int hostTickWait()
+{
+	int next = timerNext();
+	if (next <= 0)
+		return next;
+	long us = next * TIMER_TICK_MS * 1000L - (long)(clockMicros() - tickTime);
+	return (us > 0) ? (us + 999) / 1000 : 0;
+}
+
+/**
+ * \brief Count the ticks that have passed since the last call and run the
+ * timers that are due.
+ */
+void hostTick()
+{
+	unsigned long now = clockMicros();
+	if (timerNext() < 0) {
+		// Nothing to expire, don't count the idle ticks one at a time
+		tickTime = now;
+		return;
+	}
+	while (now - tickTime >= TIMER_TICK_MS * 1000UL) {
+		tickTime += TIMER_TICK_MS * 1000UL;
+		timerTick();
+	}
+	timerPoll();
+}
+
+/**
+ * \brief Paint HOST_STACK bytes of stack for the stack command. The area
+ * is this function's frame, so it is free again once it returns and the
+ * monitor's calls from main() run down through it.
+ * \note Call from main() before running the monitor.
+ */
+__attribute__((noinline)) void hostStackPaint()
+{
+#ifdef INCL_STACK
+	unsigned char area[HOST_STACK];
+	stackPaint(area, area + HOST_STACK);
+#endif
+}
@@ -0,0 +1,48 @@
+/**
+ * \file host.h
+ * \brief Services the monitor needs from a Unix host.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_HOST_H)
+#define _HOST_H
+
+#include <stdbool.h>
+
+#define SIM_MEM_SIZE	0x10000		//!< Size of simulated memory at address 0
+#define SIM_FILE_BASE	0x10000		//!< Address of a file mapped by hostMapFile()
+#define HOST_STACK		0x10000		//!< Bytes of stack painted by hostStackPaint()
+#define SIM_SENSOR		0xFFF0		//!< Simulated sensor, 16 bits, stepped by capture
+#define SENSOR_STALL_US	25000		//!< Time the sensor's interrupt holds the CPU
+
+extern void hostMemInit();
+extern bool hostMemShare(const char* name);
+extern bool hostMapFile(const char* path);
+extern bool hostStoreFile(const char* path);
+extern void hostTickStart();
+extern int hostTickWait();
+extern void hostTick();
+extern void hostStackPaint();
+
+#endif
@@ -30,8 +30,21 @@
 
 #include "token.h"
 
-extern void lexerStart(const char* s);
-extern token_t* lexer();
-extern void lexerClose();
+/**
+ * Most nested evaluations (!"..."), counting the command line. Each level
+ * holds its token arrays on the stack and its tokens in the pool, a nested
+ * command is also refused when fewer than NEST_TOKENS tokens are free.
+ */
+#if !defined(MAX_NEST)
+#define MAX_NEST	4
+#endif
+#define NEST_TOKENS	8	//!< Free tokens needed to start a nested command
+#define LEX_DEPTH	MAX_NEST	//!< Most lexers that can be in progress at once
+
+extern bool lexNumber(const char* q, const char* end, unum_t base, bool neg, num_t* result);
+
+extern bool lexerStart(mon_ctx_t* ctx, const char* s);
+extern token_t* lexer(mon_ctx_t* ctx);
+extern void lexerClose(mon_ctx_t* ctx);
 
 #endif
@@ -0,0 +1,416 @@
+/**
+ * \file link.c
+ * \brief Run the monitor behind a simulated serial link and report its cost.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "monitor.h"
+#include "host.h"
+#include "timer.h"
+#include "timecmd.h"
+#include "prof.h"
+#include "main.h"
+
+#define LE			'\n'	//!< Line end, as in monitor.c for BIG builds
+#define LINK_QUEUE	4096	//!< Bytes queued in each direction
+#define SHOW_LEN	24		//!< Characters of a command shown in its report
+#define TICK_NS		(TIMER_TICK_MS * 1000000ULL)
+
+/**
+ * \brief One direction of the link, bytes wait here until the simulated
+ * UART has had time to send them.
+ */
+typedef struct {
+	char data[LINK_QUEUE];  //!< Ring of bytes
+	unsigned head;  //!< Oldest byte
+	unsigned len;  //!< Bytes waiting
+	unsigned long long due;  //!< When the oldest byte has been sent, ns
+} queue_t;
+
+static unsigned long baud = 115200;
+static unsigned frameBits = 10;  //!< Bits per character, with start, parity and stop
+static unsigned long long charNs;  //!< Time to send a character
+static unsigned lossPpm = 0;  //!< Bytes lost per million
+static unsigned long seed = 1;
+
+static mon_ctx_t ctx;
+static unsigned long long now;  //!< Simulated time, ns
+static unsigned long long txFree;  //!< When the monitor's UART is next idle
+static queue_t tx;  //!< Output waiting to be sent (pty mode)
+static bool pty = false;  //!< Running behind a pty in real time
+static int master = -1;  //!< The pty's master file descriptor
+
+static unsigned long bytesOut;  //!< Characters the monitor has sent
+static unsigned long bytesIn;  //!< Characters sent to the monitor
+static unsigned long lostOut;  //!< Characters lost on the way out
+static unsigned long lostIn;  //!< Characters lost on the way in
+static unsigned long commands;  //!< Lines entered
+static unsigned long long busyNs;  //!< Time from each command to its output draining
+
+/**
+ * \brief Read a nanosecond clock.
+ * \returns Nanoseconds.
+ */
+static unsigned long long nanos()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * \brief Decide whether the line loses a character, repeatable for a seed.
+ * \returns true if it is lost
+ */
+static bool lose()
+{
+	if (lossPpm == 0)
+		return false;
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) % 1000000) < lossPpm;
+}
+
+/**
+ * \brief Send the queued characters whose time on the line has passed
+ * out of the pty.
+ */
+static void txSend()
+{
+	while ((tx.len > 0) && (tx.due <= now)) {
+		char c = tx.data[tx.head];
+		tx.head = (tx.head + 1) % LINK_QUEUE;
+		tx.len--;
+		txFree = tx.due;
+		tx.due += charNs;
+		if (lose())
+			lostOut++;
+		else if (write(master, &c, 1) != 1)
+			ctx.monExit = true;
+	}
+}
+
+/**
+ * \brief Send output over the simulated link. Each character occupies
+ * the line for charNs whether or not it is lost. On the pty a full queue
+ * holds the monitor up until a character has gone, as a UART would.
+ * \param ctx  Monitor context of the session.
+ * \param pData  A pointer to the string.
+ * \param size  The length of the string.
+ */
+void transmit(mon_ctx_t* ctx, char *pData, unsigned size)
+{
+	PROF_ENTER(PROF_TX, p0);
+	TIME_COUNT(ctx, tx, size);
+	for (unsigned i=0; i<size; i++) {
+		if (pty) {
+			while (tx.len == LINK_QUEUE) {
+				struct timespec ts = { tx.due / 1000000000, tx.due % 1000000000 };
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+				now = nanos();
+				txSend();
+			}
+			if (tx.len == 0)
+				tx.due = ((txFree > now) ? txFree : now) + charNs;
+			tx.data[(tx.head + tx.len++) % LINK_QUEUE] = pData[i];
+		} else {
+			txFree = ((txFree > now) ? txFree : now) + charNs;
+			if (lose())
+				lostOut++;
+			else
+				putchar(pData[i]);
+		}
+		bytesOut++;
+	}
+	PROF_LEAVE(p0);
+}
+
+/**
+ * \brief Report what a command cost on the link.
+ * \param line  The command, as far as it was kept
+ * \param out  Characters sent in reply, including the echo and prompt
+ * \param ns  Time from the command's first character to its last output
+ */
+static void report(const char* line, unsigned long out, unsigned long long ns)
+{
+	commands++;
+	busyNs += ns;
+	fprintf(stderr, "%-*s %6lu bytes %9.3f ms" EOL, SHOW_LEN, line, out, ns / 1e6);
+}
+
+/**
+ * \brief Keep a printable copy of the start of a command for its report.
+ * \param line  SHOW_LEN + 1 characters
+ * \param len  Characters kept
+ * \param c  Next input character
+ */
+static void show(char* line, unsigned* len, char c)
+{
+	if (*len < SHOW_LEN)
+		line[(*len)++] = ((c >= ' ') && (c < 0x7F)) ? c : '.';
+	line[*len] = 0;
+}
+
+/**
+ * \brief Run the watches that are due by simulated time.
+ * \param ticked  Time up to which ticks have been counted
+ */
+static void simTicks(unsigned long long* ticked)
+{
+	while (now - *ticked >= TICK_NS) {
+		*ticked += TICK_NS;
+		timerTick();
+	}
+	timerPoll();
+}
+
+/**
+ * \brief Feed a session through the link as a host would type it, each
+ * line as soon as the previous prompt has arrived, in simulated time.
+ * Output that gets through goes to stdout.
+ * \param f  The session
+ */
+static void session(FILE* f)
+{
+	char line[SHOW_LEN + 1];
+	unsigned len = 0;
+	unsigned long out = bytesOut;
+	unsigned long long start = 0;
+	unsigned long long ticked = 0;
+	int c;
+
+	while (!ctx.monExit && ((c = getc(f)) != EOF)) {
+		if (len == 0) {
+			// wait for the prompt to arrive before typing
+			if (txFree > now)
+				now = txFree;
+			start = now;
+			out = bytesOut;
+		}
+		if (c != LE)
+			show(line, &len, c);
+		now += charNs;
+		bytesIn++;
+		simTicks(&ticked);
+		if (lose())
+			lostIn++;
+		else
+			processChar(&ctx, c);
+		if (c == LE) {
+			report(line, bytesOut - out, ((txFree > now) ? txFree : now) - start);
+			len = 0;
+		}
+	}
+	if (txFree > now)
+		now = txFree;
+}
+
+/**
+ * \brief Open a pty whose slave end a terminal program or test can use
+ * as if it were the target's serial port.
+ * \returns The master's file descriptor, or -1 on failure
+ */
+static int ptyOpen()
+{
+	struct termios t;
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0))
+		return -1;
+	// Hold the slave open, raw, so the master stays usable between clients
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if ((slave < 0) || (tcgetattr(slave, &t) < 0))
+		return -1;
+	cfmakeraw(&t);
+	tcsetattr(slave, TCSANOW, &t);
+	fprintf(stderr, "aMonLink: %s at %lu baud, %u bits per character" EOL,
+			ptsname(master), baud, frameBits);
+	return master;
+}
+
+/**
+ * \brief Serve the monitor on a pty in real time, characters taking as
+ * long to pass in each direction as they would on the simulated link.
+ */
+static void serve()
+{
+	static queue_t rx;  // input waiting to arrive
+	char line[SHOW_LEN + 1];  // command being typed
+	char cmd[SHOW_LEN + 1];  // command whose output is being sent
+	unsigned len = 0;
+	unsigned long out = 0, cmdOut = 0;
+	unsigned long long start = 0, cmdStart = 0;
+	unsigned long long rxFree = 0;
+	bool pending = false;  // a command's output is still being sent
+	struct pollfd pfd = { master, POLLIN, 0 };
+
+	hostTickStart();
+	while (!ctx.monExit || (tx.len > 0)) {
+		// sleep until input, a character is due in either direction or a timer
+		long long wait = hostTickWait() * 1000000LL;
+		if ((rx.len > 0) && ((wait < 0) || (rx.due - now < wait)))
+			wait = (rx.due > now) ? rx.due - now : 0;
+		if ((tx.len > 0) && ((wait < 0) || (tx.due - now < wait)))
+			wait = (tx.due > now) ? tx.due - now : 0;
+		struct timespec ts = { wait / 1000000000, wait % 1000000000 };
+		pfd.events = (rx.len < LINK_QUEUE) ? POLLIN : 0;
+		if ((ppoll(&pfd, 1, (wait < 0) ? NULL : &ts, NULL) > 0) && (pfd.revents & POLLIN)) {
+			char buf[256];
+			unsigned space = LINK_QUEUE - rx.len;
+			int n = read(master, buf, (space < sizeof(buf)) ? space : sizeof(buf));
+			now = nanos();
+			for (int i=0; i<n; i++) {
+				rxFree = ((rxFree > now) ? rxFree : now) + charNs;
+				if (rx.len == 0)
+					rx.due = rxFree;
+				rx.data[(rx.head + rx.len++) % LINK_QUEUE] = buf[i];
+			}
+		}
+		now = nanos();
+		hostTick();
+		// characters that have arrived go to the monitor
+		while ((rx.len > 0) && (rx.due <= now) && !ctx.monExit) {
+			char c = rx.data[rx.head];
+			rx.head = (rx.head + 1) % LINK_QUEUE;
+			rx.len--;
+			rx.due += charNs;
+			if (len == 0) {
+				// typed ahead, the previous command's output is cut short
+				if (pending)
+					report(cmd, bytesOut - cmdOut, now - cmdStart);
+				pending = false;
+				start = now;
+				out = bytesOut;
+			}
+			if (c != LE)
+				show(line, &len, c);
+			bytesIn++;
+			if (lose())
+				lostIn++;
+			else
+				processChar(&ctx, c);
+			if (c == LE) {
+				strcpy(cmd, line);
+				cmdOut = out;
+				cmdStart = start;
+				pending = true;
+				len = 0;
+			}
+		}
+		// characters that have been sent leave the link
+		txSend();
+		if (pending && (tx.len == 0)) {
+			report(cmd, bytesOut - cmdOut, txFree - cmdStart);
+			pending = false;
+		}
+	}
+}
+
+/**
+ * \brief Parse a character frame such as 8N1 or 7E2.
+ * \param s  The frame
+ * \returns Bits per character including the start bit, 0 if s is not valid
+ */
+static unsigned framing(const char* s)
+{
+	if ((strlen(s) != 3) || (s[0] < '5') || (s[0] > '9') ||
+		!strchr("NEO", s[1]) || (s[2] < '1') || (s[2] > '2'))
+		return 0;
+	return 1 + (s[0] - '0') + (s[1] != 'N') + (s[2] - '0');
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: aMonLink [-b baud] [-f 8N1] [-l loss%%] [-s seed] [session]\n");
+	exit(2);
+}
+
+/**
+ * \brief Run the monitor behind a simulated serial link: a session file
+ * in simulated time with its output on stdout, or without one on a pty in
+ * real time. Each command's bytes and link time go to stderr.
+ * \param argc  Argument count
+ * \param argv  Options and an optional session file
+ * \returns 0, or 2 on error
+ */
+int main(int argc, char* argv[])
+{
+	int opt;
+	FILE* f = NULL;
+
+	while ((opt = getopt(argc, argv, "b:f:l:s:")) != -1) {
+		if (opt == 'b')
+			baud = strtoul(optarg, NULL, 0);
+		else if (opt == 'f')
+			frameBits = framing(optarg);
+		else if (opt == 'l')
+			lossPpm = atof(optarg) * 10000;
+		else if (opt == 's')
+			seed = strtoul(optarg, NULL, 0);
+		else
+			usage();
+	}
+	if ((baud == 0) || (frameBits == 0) || (optind + 1 < argc))
+		usage();
+	charNs = frameBits * 1000000000ULL / baud;
+	hostMemInit();
+	if (optind < argc) {
+		f = fopen(argv[optind], "rb");
+		if (f == NULL) {
+			perror(argv[optind]);
+			return 2;
+		}
+	} else {
+		master = ptyOpen();
+		if (master < 0) {
+			perror("aMonLink");
+			return 2;
+		}
+		pty = true;
+		now = nanos();
+	}
+
+	monInit(&ctx);
+	transmit(&ctx, ctx.prompt, strlen(ctx.prompt));
+	transmit(&ctx, " ", 1);
+	if (pty) {
+		serve();
+	} else {
+		session(f);
+		transmit(&ctx, EOL, 1);
+		fclose(f);
+	}
+	fprintf(stderr, "%lu commands, %lu bytes out, %lu in, %lu lost out, %lu in,"
+			" %.3f ms busy at %lu baud" EOL,
+			commands, bytesOut, bytesIn, lostOut, lostIn, busyNs / 1e6, baud);
+	return 0;
+}
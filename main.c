@@ -57,14 +57,33 @@
  *
  * \section command_sec Commands
  *
- * Ten commands are included in the monitor: <br/>
+ * Twenty nine commands are included in the monitor: <br/>
  *     prompt(s) - Select the prompt for input <br/>
  *       set(cs) - Set register to string <br/>
  *        get(c) - Display register <br/>
  *       add(dd) - Add two numbers <br/>
  *       sub(dd) - Subtract two numbers <br/>
  *       mul(dd) - Multiply two numbers <br/>
+ *     watch(ds) - Repeat command every d ms <br/>
+ *    unwatch(d) - Stop repeating command <br/>
+ *      time(s+) - Time command, [runs] cmd <br/>
+ *  memtest(dd+) - Test RAM, addr len [pattern] <br/>
+ *  memfault(dd) - Inject stuck bit, addr bit <br/>
+ *      peek(d+) - Read memory, addr [width] <br/>
+ *     poke(dd+) - Write memory, addr val [width] <br/>
+ *     fill(ddd) - Fill memory, addr len byte <br/>
+ *     copy(ddd) - Copy memory, dst src len <br/>
+ *      crc(dd+) - Checksum, addr len [algo] <br/>
+ *     find(dd+) - Search, addr len pat [width] <br/>
+ *  capture(ddd) - Sample addr, count period_us <br/>
+ *    readout(+) - Send capture, [bin] <br/>
+ *       stack() - Stack high water mark <br/>
+ *        save() - Save registers & settings <br/>
+ *     restore() - Restore saved settings <br/>
+ *       prof(s) - Profile, start|stop|report <br/>
+ *      trace(s) - Event trace, dump|clear <br/>
  *         hex() - Toggle output base <br/>
+ *        ansi() - Toggle ANSI line editing <br/>
  *      echo(s+) - Display parameter <br/>
  *        help() - Display this help <br/>
  *        exit() - Exit monitor <br/>
@@ -78,14 +97,67 @@
  * A parameter can be replaced by a command in a string by preceding it with a '!'.
  * Example: To set register a to the sum of 3 and 5 enter the command <b>set a !"add 3 5"</b>.
  *
+ * \section expr_sec Expressions
+ *
+ * The last parameter can be an infix expression: everything after an '='
+ * up to the end of the line, e.g. <b>set b =($a + 3) * 2 & 0xFF</b>. It is
+ * evaluated into a number before the command runs, without lexing and
+ * running a nested command for each operator. Numbers, registers ($a) and
+ * parentheses may be combined with C's operators and precedence: unary
+ * - ~ !, * / %, + -, << >>, < <= > >=, == !=, &, ^, |, && and ||.
+ * Math wraps at NUM_BITS, >> keeps the sign, comparisons and logical
+ * operators give 0 or 1. Errors are reported as <b># Expression Error #</b>,
+ * <b># Divide By Zero #</b> or, past EXPR_DEPTH (expr.h) pending operands
+ * or operators, <b># Expression Too Deep #</b>. Watched expressions are
+ * evaluated on every run.
+ *
  * \section addCmd_sec Adding commands
  *
  * To add a command named 'newcmd'.
  * In the commands.c module:
  * Add a <b>MK_CMD(newcmd);</b> with the other function definitions.
- * Add a <b>CMD(newcmd, "parameter codes", "Command description")</b> entry to the dsp_table.
+ * Add a <b>CMD(newcmd, "parameter codes", "Command description")</b> entry to the dsp_table,
+ * the name under CMD_NAME_LEN and the description under CMD_DOC_LEN characters.
  * In the commands.c module or, preferably, a new module:
- * Add a function <b>token_t* cmd_newcmd(token_t *args[], int nArgs)</b> to implement the new command.
+ * Add a function <b>token_t* cmd_newcmd(mon_ctx_t* ctx, token_t *args[], int nArgs)</b> to implement the new command.
+ * Keep any per session state in struct mon_ctx (context.h) rather than in statics.
+ * Send output with the emit functions (emit.h): emitString for literals,
+ * emitStr for text of known length, emitPad for spaces and emitNum,
+ * emitDec, emitUnsigned and emitHex for numbers, which format into a
+ * buffer on the stack and go straight to transmit(). The format functions
+ * (print.h) take the caller's buffer, so there is no static buffer for
+ * one session, or a watch, to overwrite under another. Report errors with
+ * <b>emitError(ctx, r, MSG_ID)</b>, adding the message to the MESSAGES
+ * list in text.h if it is new. An error with a variable part is sent
+ * between emitErrorOpen() and emitErrorClose(), its fixed parts also
+ * MESSAGES sent with textEmit().
+ *
+ * \section history_sec Line Editing and History
+ *
+ * Left and right arrows (or ^B and ^F), home and end (or ^A and ^E) move
+ * the cursor, characters are inserted at the cursor, backspace deletes the
+ * character before it and delete the one under it. Each edit sends only
+ * the changed end of the line. ANSI cursor control sequences are used when
+ * they are shorter than backspaces, <b>ansi</b> toggles them off for dumb
+ * terminals.
+ *
+ * Entered lines are kept in a ring of HIST_SIZE bytes, each packed as a
+ * length and its characters, so short commands take little room. A line
+ * that repeats the previous one is not kept again. Up arrow (or ^U) and
+ * down arrow (or ^D) step through the history. ^R starts a reverse search,
+ * the console shows <b>[pattern] match</b>; typing extends the pattern,
+ * ^R finds the next older match and any other control character ends the
+ * search leaving the match as the input line.
+ *
+ * With INCL_STREAM the line is lexed as it is typed: each time a space,
+ * comma or bracket ends a token outside a string the tokens before it are
+ * lexed and kept, so at the line end only the last token is left to lex
+ * before the command runs. Editing lexed text, e.g. backspacing over a
+ * separator, frees the tokens lexed from it, and nothing after an '='
+ * expression is lexed early. Lexed tokens come from the session's pool,
+ * NEST_TOKENS are always left free for watches. On the replay script this
+ * cuts the median time from line end to result by about a fifth, at the
+ * cost of more work per character typed.
  *
  * \section regiter_sec Registers
  *
@@ -96,35 +168,337 @@
  * The value of a register can be inserted into a command by prefixing the
  * name of the register with a $ sign.
  * \note <b>get a</b> is equivalent to <b>echo $a</b>.
- * \note To increment register a enter <b>set a !"add $a 1"</b>.
+ * \note To increment register a enter <b>set a =$a + 1</b> (or <b>set a !"add $a 1"</b>).
+ *
+ * \section watch_sec Watches
+ *
+ * <b>watch 100 "get a"</b> repeats the command every 100 ms and displays
+ * its result, prefixed with the watch number, only when the result changes.
+ * The command is lexed once when the watch starts; registers ($a) and
+ * commands (!"...") in it are evaluated each time. The watch command returns
+ * the watch number, <b>unwatch 1</b> stops watch 1. Up to MAX_WATCHES
+ * commands can be watched at once. Watches run from the timers in timer.c,
+ * the target calls timerTick() every TIMER_TICK_MS, e.g. from SysTick, and
+ * timerPoll() from its main loop. main.c counts ticks from the clock as
+ * it wakes, see \ref event_sec.
+ *
+ * \section event_sec Event Loop
+ *
+ * event.c runs the main loop: interrupts (or a host's idle hook) post
+ * EV_INPUT when characters arrive, EV_TICK for timer ticks and EV_TX when
+ * output has drained, eventRun() calls the handler set for each with
+ * eventOn() and, when nothing is pending, the idle hook set with
+ * eventIdle(). A target's hook can enter
+ * WFI or a sleep mode rather than polling the UART, it is called with
+ * EVENT_LOCK() held so a post can't slip in between the check and the
+ * sleep, and posts with eventPostLocked() so as not to release it.
+ * main.c's hook sleeps in poll() until input arrives, timerNext() says a
+ * timer is due or, while output is buffered, the console can take more,
+ * so an idle console no longer wakes every millisecond; aMonServer
+ * likewise sleeps in epoll_wait(). main.c buffers output as a UART
+ * driver's ring would, EV_TX writes the next piece when the console
+ * drains and transmit() only waits when the buffer is full.
+ *
+ * \section time_sec Timing Commands
+ *
+ * <b>time "cmd"</b> evaluates the command, as '!' would, and reports the
+ * elapsed microseconds split into time in the lexer, in dispatch (eval and
+ * argument checking) and in the command function, then the number of tokens
+ * allocated and the bytes transmitted. <b>time 10 "cmd"</b> runs it ten
+ * times and reports the minimum, median and maximum elapsed time and the
+ * average of the rest, up to TIME_MAX_RUNS runs: 32 in BIG builds, 8
+ * otherwise, as the run times are kept on the stack. The result of the
+ * last run is returned.
+ *
+ * \section memtest_sec Memory Test
+ *
+ * <b>memtest addr len [pattern]</b> runs March C- with 'pattern' (default 0)
+ * as the background, then walking ones, over the native words in the range
+ * and reports the bytes per second it achieved, or the first failing address.
+ * ^C (the target's UART ISR sets monCancel) stops it between chunks.
+ * Addresses are translated by memAddr(), main.c simulates 64K at address 0
+ * with an mmap'd region, <b>memfault addr bit</b> (BIG builds only) makes
+ * a bit there stuck at one so detection can be checked.
+ *
+ * \section mem_sec Memory Access
+ *
+ * <b>peek addr [width]</b> returns the 1, 2, 4 or 8 byte value at addr
+ * and <b>poke addr value [width]</b> writes one, each as a single volatile
+ * access, so the address must be a multiple of the width, as peripheral
+ * registers need. The width defaults to that of a number (NUM_BITS) and
+ * can't be wider. <b>fill addr len byte</b> and <b>copy dst src len</b>
+ * work a native word at a time, four to a loop, between any unaligned
+ * ends; copy handles overlap like memmove and uses bytes when dst and src
+ * are differently aligned. Every address goes through memAddr(): a target
+ * just casts it, main.c simulates 64K at 0 and <b>aMon -s /name</b> puts
+ * that in a POSIX shared memory object so a simulator can attach.
+ *
+ * \section crc_sec Checksums
+ *
+ * <b>crc addr len [algo]</b> checksums memory in place and returns the
+ * sum, after a line with the length and bytes/s. Comparing it with the
+ * image's checksum avoids reading a flash image out over the link. algo is
+ * crc32 (the default, as zlib), crc16 (CCITT, initial 0xFFFF), fletcher
+ * (Fletcher-16) or adler (Adler-32). A sum that doesn't fit a number
+ * (NUM_BITS 16) is reported as <b># Number Out Of Range #</b>. CRC_KERNEL
+ * picks the CRC code at build time: CRC_NIBBLE uses 16 entry tables for
+ * tiny parts, CRC_SLICE8 (BIG builds) eight 256 entry tables built on
+ * first use, about six times faster on a host, and CRC_ARM the ARMv8 CRC32
+ * instructions where the compiler offers them. Fletcher and Adler take
+ * their modulus once per block. ^C stops a long checksum. On a host,
+ * <b>aMon -m image</b> maps the file at 0x10000 to checksum it there.
+ *
+ * \section find_sec Search
+ *
+ * <b>find addr len pattern [width]</b> prints the address of each match
+ * in the region, up to FIND_MAX, and returns how many it printed. A string
+ * pattern is matched at any address: short ones by memchr() on the first
+ * byte, from FIND_HORSPOOL bytes with Horspool's skip table. A number is a
+ * word of width 1, 2, 4 or 8 bytes (default the size of a number) matched
+ * only at multiples of the width, as peek reads it, e.g. <b>find 0x2000
+ * 0x800 0xDEADBEEF 4</b> for a stack canary. ^C stops a long search, and
+ * on a host <b>aMon -m image</b> searches a mapped file at 0x10000.
+ *
+ * \section capture_sec Capture
+ *
+ * <b>capture addr count period</b> reads the NUM_BITS word at addr count
+ * times (up to CAPTURE_SIZE), period microseconds apart or as fast as
+ * possible if period is 0, into a static buffer without printing anything,
+ * and returns the number of samples taken. ^C stops it early. <b>readout</b>
+ * then sends a line with the number of samples, the period and how many
+ * were taken a period or more late, followed by the samples delta and run
+ * length encoded in hex: <b>=1A0 +4 *3 -10</b> is 0x1A0, 0x1A4, then three
+ * more 4 higher, then 0x10 lower. A '*' run repeats the last difference,
+ * which starts as 0. <b>readout bin</b> sends binary frames instead, see
+ * capture.c. <b>aMon -m file</b> maps the file at SIM_FILE_BASE (0x10000),
+ * shared, so another process can play a peripheral by writing it. The
+ * address must be aligned to the word. On the host the 16 bit word at
+ * SIM_SENSOR (0xFFF0) is a simulated sensor that capture steps after each
+ * sample, through the CAPTURE_STEP hook in main.h. Its pattern repeats
+ * every ten samples, with one 25 ms stall that makes the next sample late,
+ * so test8 can check the readout.
+ *
+ * \section stack_sec Stack Use
+ *
+ * Each nested command (!"...") runs eval() again, with its token arrays on
+ * the stack and its tokens in the pool. eval() refuses to go more than
+ * MAX_NEST (lexer.h) deep, counting the command line, or to start a nested
+ * command with fewer than NEST_TOKENS tokens free, returning
+ * <b># Nesting Too Deep #</b> instead, so <b>set a "echo !$a"</b>
+ * <b>echo !$a</b> fails cleanly rather than overrunning the stack.
+ * A nested command's error stops the command it is in.
+ *
+ * The target paints its stack at startup with stackPaint(), main.c paints
+ * HOST_STACK bytes below main(). <b>stack</b> then reports how much of
+ * it has been overwritten and the deepest nesting seen in the session, run
+ * it after exercising the commands to size the stack reservation. The
+ * makefile builds with -fstack-usage, <b>make stackusage</b> lists the
+ * functions using the most stack.
+ *
+ * \section store_sec Saved Settings
+ *
+ * <b>save</b> keeps the registers, prompt and output base and ANSI settings
+ * in flash, reached through flashPage(), flashWrite() and flashErase()
+ * (main.h), and they are restored at startup. The store is a log of
+ * records, key, length, value and CRC-16, appended to one of STORE_PAGES
+ * pages (store.h). Only values that changed since they were last saved or
+ * restored are appended, so a save is usually a few bytes and restoring is
+ * one pass over the page with no buffering. When the page is full the next
+ * page is erased, the current values written to it and then its header,
+ * whose sequence number makes it the active page, so a reset part way
+ * through a save loses at most that save. A record cut short by a reset
+ * fails its CRC, ends the restore and makes the next save compact.
+ * <b>aMon -k file</b> keeps the pages in a file, without it <b>save</b>
+ * and <b>restore</b> report <b># No Store #</b>.
+ *
+ * \section prof_sec Profiling
+ *
+ * <b>prof start</b> samples what the monitor is doing every PROF_PERIOD_US
+ * of CPU time until <b>prof stop</b>, and <b>prof report</b> prints a
+ * histogram of the samples: lexing, dispatch, each command's function,
+ * token allocation, number formatting, transmit and everything else. The
+ * phase is a global marker set by PROF_ENTER (prof.h) where each starts and
+ * put back where it ends, so nested commands are counted in the command
+ * that is running. The port calls profSample() from a timer interrupt
+ * started by profTimer() (main.h), SIGPROF on a host, so boards that can't
+ * run a profiler still show where the time goes.
+ *
+ * \section trace_sec Tracing
+ *
+ * TRACE points (trace.h) in eval(), lexerStart() and lexerClose(),
+ * command(), tokenAlloc() and tokenFree() and setReg() write an 8 byte
+ * record, the point, a 16 bit argument and the time, into a ring of the
+ * last TRACE_SIZE. Without INCL_TRACE they compile to nothing. After
+ * <b># Token pool empty #</b> or a nested command going wrong,
+ * <b>trace dump</b> sends the ring as hex, oldest first, and <b>aMonTrace
+ * [file]</b> turns the captured output into a timeline of the steps that
+ * led there, each with its time from the first and from the one before.
+ * <b>trace clear</b> empties the ring. <b>make test</b> decodes a real dump
+ * of testfiles/trace2, less its times, so the two stay in step.
+ *
+ * \section session_sec Sessions
+ *
+ * Everything a session needs, the input line, history, token pool,
+ * registers and lexer stack, is in a mon_ctx_t (context.h) which is passed
+ * to every function, so one monitor can serve several independent
+ * sessions. A target has one, initialised by monInit(), and points its
+ * 'port' member at whatever transmit() needs. Watches belong to the
+ * session that started them, watchStop() ends them when it closes.
+ *
+ * <b>make aMonServer</b> builds a host server that accepts clients on a
+ * Unix socket (/tmp/aMon.sock or the path given) and runs a session for
+ * each from one epoll loop, e.g. <b>socat -,raw,echo=0 UNIX:/tmp/aMon.sock</b>.
+ * Output is queued per session and sent as the socket accepts it, a client
+ * that lets SESSION_OUT bytes back up is dropped. Sessions share the timers
+ * and simulated memory, and a long command in one delays the others.
+ *
+ * \section replay_sec Replay
+ *
+ * <b>make replay</b> builds aMonReplay and feeds each test session through
+ * processChar() in-process, as many times as -r asks, checking the output
+ * against the expect file and timing each line from its line end until the
+ * next prompt has been sent. It reports the median, 99th percentile and
+ * maximum line latency in nanoseconds and the lines per second the monitor
+ * sustained. <b>aMonReplay -g 10000</b> writes a larger script mixing
+ * registers, math, nested commands, history and line editing, the same
+ * each time so runs can be compared.
+ *
+ * <b>make batch</b> runs aMonReplay -b over the test sessions on a pool of
+ * worker processes, one per core unless -j says otherwise. Each worker
+ * claims the next unclaimed session and forks to replay it, so every
+ * session starts from a fresh monitor and module state and one slow
+ * session never holds up a queue behind it. Output is normalised as
+ * make test's sed does and compared in memory with expectN_bits, or
+ * expectN if there is none. It prints each session's lines and time, then
+ * a count of failures, the wall time and sessions per second.
+ *
+ * \section link_sec Serial Link
+ *
+ * On a real link the output, echo, prompts and error messages, costs more
+ * than the commands. <b>aMonLink [-b baud] [-f 8N1] [-l loss%] [-s seed]
+ * session</b> feeds a session through a simulated UART in simulated time,
+ * each line typed once the previous prompt has arrived, with the output
+ * that gets through on stdout. Without a session it serves the monitor on
+ * a pty, named on stderr, in real time, so a terminal program or test can
+ * use it like the target's port. Either way every character takes its
+ * frame's bits at the baud rate, -l loses that percentage of characters
+ * in each direction (repeatably for a seed), and each command's bytes out
+ * and time from its first character to its last output are reported on
+ * stderr, then the totals. <b>make serial</b> reports the test sessions
+ * at 9600 baud. Timers tick in simulated time too, so <b>make test</b>
+ * runs testfiles/watch1 here to check that a watch prints its first
+ * result and then only when the result changes.
+ *
+ * \section pgm_sec Program Memory
+ *
+ * The command table, the help text and the error messages are const data
+ * read through pgm.h, so on an AVR they stay in flash (PROGMEM, read with
+ * pgm_read_byte and memcpy_P) rather than being copied to SRAM at startup.
+ * The table holds its strings in fixed size arrays so there are no
+ * pointers to chase. Literals go to flash with <b>emitPgmString</b>
+ * (emit.h), other targets read them as plain const data.
+ * With <b>PGM_COUNT</b> the host counts each read, and aMonReplay reports
+ * the flash reads per line.
+ *
+ * \section text_sec Packed Text
+ *
+ * The error messages (MESSAGES in text.h) and, with INCL_PACK, the help of
+ * each command are numbered texts sent with textEmit or copied into an ERR
+ * token with textCopy. With INCL_PACK the build runs <b>textpack</b> on
+ * commands.c, preprocessed with the monitor's flags so only the commands
+ * built in are packed, and it writes textdata.c: every text byte pair
+ * encoded, codes from 128 up standing for a pair of codes, and the pair
+ * table shared by all. The decoder expands pairs on a stack of TEXT_DEPTH
+ * bytes and sends the characters as they come, 16 at a time, so there is
+ * no buffer for the whole text. textpack checks that each text unpacks
+ * and reports the bytes saved, the saving grows with each command added.
+ *
+ * \section client_sec Client Library
+ *
+ * libamonclient (amonclient.h) drives a monitor from host automation.
+ * amonOpen() connects to a serial device, a pty such as aMonLink's or
+ * aMonServer's socket, amonSpawn() starts aMon on a pty. amonSend() queues
+ * a command with a callback, up to AMON_QUEUE of them; at most the
+ * window's commands are sent ahead of their output. The output after each
+ * echoed command up to the next prompt becomes its result: AMON_NUM with
+ * the value, AMON_ERR with the message of a final "# ... #" line, AMON_STR
+ * or AMON_EMPTY. Poll amonFd() for amonEvents() and call amonProcess(),
+ * or call amonWait(); callbacks run from there in submission order. The
+ * prompt must stay "> " and unsolicited output, such as watches, can be
+ * mistaken for a result. <b>make test</b> runs amonClientTest against aMon.
  *
  * \section install_sec Installation
  *
- * All the c, h & re2c files here except main.h and main.c are part of
- * the monitor. main.c and main.h are included to allow building a "test
- * version" that runs in a unix environment. 
+ * All the c, h & re2c files here except main.h, main.c, host.h, host.c,
+ * server.c, replay.c, link.c, amonclient.h, amonclient.c and clienttest.c
+ * are part of the monitor. main.c and main.h are included to allow
+ * building a "test version" that runs in a unix environment, host.c has
+ * the services it, server.c, replay.c and link.c share. 
  * 
  * \subsection build_sec Building
  * Two non-standard tools are required:<br/>
  * re2c - "A tool for writing very fast and very flexible scanners." is available at 'http://re2c.org/'.<br/>
  * unifdef - "A utility selectively processes conditional C preprocessor #if and #ifdef directives." is available at 'http://dotat.at/prog/unifdef/'.<br/>
  * Once the preceding tools are installed just make.<br/>
- * There are four flags defined in the makefile, they are included to allow shrinking the monitor when flash or ram are in short supply:<br/>
+ * The makefile defines the flags below, most are included to allow shrinking
+ * the monitor when flash or ram are in short supply. CFLAGS holds:<br/>
+ * <b>BIG</b> Build for hosted environment, i.e. lots of space.<br/>
+ * <b>INCL_MATH</b> Include math commands (add, sub & mul).<br/>
+ * <b>INCL_WATCH</b> Include watch commands (watch & unwatch).<br/>
+ * <b>INCL_MEMTEST</b> Include memtest command.<br/>
+ * <b>INCL_TIME</b> Include time command and the counters it reports.<br/>
+ * <b>INCL_CAPTURE</b> Include capture and readout commands.<br/>
+ * <b>INCL_MEM</b> Include peek, poke, fill and copy commands.<br/>
+ * <b>INCL_CRC</b> Include crc command.<br/>
+ * <b>INCL_FIND</b> Include find command.<br/>
+ * <b>INCL_STACK</b> Include stack command and stack painting.<br/>
+ * <b>INCL_STORE</b> Include save and restore commands and restoring at startup.<br/>
+ * <b>INCL_PROF</b> Include prof command and the phase markers it samples.<br/>
+ * <b>INCL_TRACE</b> Include trace command and the trace points.<br/>
+ * <b>INCL_STREAM</b> Lex the input line as it is typed.<br/>
+ * <b>INCL_PACK</b> Pack the help and messages with textpack.<br/>
+ * <b>PGM_COUNT</b> Count program memory reads (host only, pgm.h).<br/>
+ * <b>NUM_BITS</b> Width of numbers, 16 (e.g. AVR), 32 (the default) or 64
+ * (timestamps and addresses on 32 bit parts). Parsing, printing and math all
+ * use that width, numbers that don't fit are reported as
+ * <b># Number Out Of Range #</b>, math wraps. <b>make testwidths</b> tests
+ * each.<br/>
+ * FLAGS holds the three that must be undef'd (-U) to remove them:<br/>
  * <b>INCL_REG</b> Include support for registers <br/>
  * <b>INCL_EXIT</b> Include "exit" command.<br/>
- * <b>INCL_MATH</b> Include math commands (add, sub & mul).<br/>
- * <b>BIG</b> Build for hosted environment, i.e. lots of space.<br/>
+ * <b>INCL_EXPR</b> Include '=' infix expressions.<br/>
+ * The textpack rule adds <b>TEXT_SCAN</b> to pull the help and messages out of
+ * commands.c.<br/>
+ * A port may also define:<br/>
+ * <b>MAX_NEST</b> Most nested commands, 4 by default (lexer.h).<br/>
+ * <b>CRC_KERNEL</b> CRC-32 kernel, CRC_NIBBLE, CRC_SLICE8 or CRC_ARM, chosen
+ * from the target by default (crc.h).<br/>
+ * <b>EVENT_LOCK</b> and <b>EVENT_UNLOCK</b> Guard the pending events against
+ * interrupts, empty by default (event.h).<br/>
+ * <b>CAPTURE_STEP</b> Called after each capture sample, main.h uses it to step
+ * the simulated sensor (capture.c).<br/>
  */
  
- #include <stdio.h>
+#define _GNU_SOURCE
+#include <stdio.h>
 #include <unistd.h>
 #include <termios.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <poll.h>
+#include <signal.h>
+#include <limits.h>
 
 #include "monitor.h"
+#include "host.h"
+#include "timecmd.h"
+#include "prof.h"
+#include "event.h"
+#ifdef INCL_STORE
+#include "store.h"
+#endif
 #include "main.h"
 
 
@@ -134,25 +508,151 @@
 #define DEBUG(s)
 #endif
 
+#define TX_SIZE		4096	//!< Console output buffer
+
 static struct termios old_tio, new_tio;
- 
+static mon_ctx_t ctx;	//!< The console's session
+static struct pollfd fds[2] = {
+	{ STDIN_FILENO, POLLIN, 0 },	//!< Console input
+	{ -1, POLLOUT, 0 },	//!< Console output, STDOUT_FILENO while txLen > 0
+};
+static char txBuf[TX_SIZE];	//!< Output waiting for the console
+static unsigned txHead;	//!< Oldest byte in txBuf
+static unsigned txLen;	//!< Bytes waiting
+
+/**
+ * \brief Write waiting output to the console.
+ * \param max  Most bytes to write, PIPE_BUF after POLLOUT can't block
+ */
+static void txWrite(unsigned max)
+{
+	while ((txLen > 0) && (max > 0)) {
+		int n = write(STDOUT_FILENO, txBuf + txHead, (txLen < max) ? txLen : max);
+		if (n <= 0) {
+			txLen = 0;	// the console has gone, as has the output
+			break;
+		}
+		txHead += n;
+		txLen -= n;
+		max -= n;
+	}
+	if (txLen == 0)
+		txHead = 0;
+}
+
 /**
- * \brief Print a string on the console.
+ * \brief Print a string on the console, buffered until the console can
+ * take it. Waits, as a UART driver would, only when the buffer is full.
+ * \param ctx  Monitor context of the session.
  * \param pData  A pointer to the string.
  * \param size  The length of the string.
  */
-void transmit(char *pData, unsigned size)
+void transmit(mon_ctx_t* ctx, char *pData, unsigned size)
+{
+	PROF_ENTER(PROF_TX, p0);
+	TIME_COUNT(ctx, tx, size);
+	while (size > 0) {
+		if (txLen == TX_SIZE)
+			txWrite(TX_SIZE);
+		if (txHead + txLen == TX_SIZE) {
+			memmove(txBuf, txBuf + txHead, txLen);
+			txHead = 0;
+		}
+		unsigned n = TX_SIZE - txHead - txLen;
+		if (n > size)
+			n = size;
+		memcpy(txBuf + txHead + txLen, pData, n);
+		txLen += n;
+		pData += n;
+		size -= n;
+	}
+	PROF_LEAVE(p0);
+}
+
+/**
+ * \brief ^C stops long running commands rather than the monitor.
+ */
+static void interrupt(int sig)
+{
+	ctx.monCancel = true;
+}
+
+/**
+ * \brief Idle hook, sleep until input arrives, a timer is due or the
+ * console can take more of the waiting output.
+ */
+static void waitEvents(void* arg)
+{
+	fds[1].fd = (txLen > 0) ? STDOUT_FILENO : -1;	// poll() skips -1
+	if (poll(fds, 2, hostTickWait()) > 0) {
+		if (fds[0].revents & (POLLIN | POLLHUP))
+			eventPostLocked(EV_INPUT);
+		if (fds[1].revents & (POLLOUT | POLLERR | POLLHUP))
+			eventPostLocked(EV_TX);
+	}
+	if (hostTickWait() == 0)
+		eventPostLocked(EV_TICK);
+}
+
+/**
+ * \brief The console has drained, write it the next piece of output.
+ */
+static void output(void* arg)
+{
+	txWrite(PIPE_BUF);
+}
+
+/**
+ * \brief Pass the waiting input characters to the monitor.
+ */
+static void input(void* arg)
+{
+	char buf[64];
+	int n = read(STDIN_FILENO, buf, sizeof(buf));
+	if (n <= 0)
+		ctx.monExit = true;
+	for (int i=0; (i<n) && !ctx.monExit; i++)
+		processChar(&ctx, buf[i]);
+}
+
+/**
+ * \brief Run the timers that are due.
+ */
+static void tick(void* arg)
 {
-	for (int i=0; i<size; i++)
-		putchar(pData[i]);
+	hostTick();
 }
 
 /**
- * \brief Collect input characters and pass them to monitor
+ * \brief Run the console session from the event loop: input characters
+ * go to the monitor, timers run when due and between them the idle hook
+ * sleeps in poll() rather than waking every tick.
+ * \param argc  Argument count
+ * \param argv  Options, '-m file' maps the file at SIM_FILE_BASE, '-s name'
+ * puts the simulated memory in shared memory object 'name', '-k file'
+ * keeps saved settings in the file
  */
-int main()
+int main(int argc, char* argv[])
 {
-	char c;
+	int opt;
+	bool ok = true;
+
+	hostStackPaint();
+	hostMemInit();
+	while ((opt = getopt(argc, argv, "m:s:k:")) != -1) {
+		if (opt == 'm')
+			ok = ok && hostMapFile(optarg);
+		else if (opt == 's')
+			ok = ok && hostMemShare(optarg);
+		else if (opt == 'k')
+			ok = ok && hostStoreFile(optarg);
+		else
+			ok = false;
+	}
+	if (!ok) {
+		fprintf(stderr, "usage: aMon [-m file] [-s shm_name] [-k store_file]\n");
+		return 1;
+	}
 
 	/* get the terminal settings for stdin */
 	tcgetattr(STDIN_FILENO,&old_tio);
@@ -166,16 +666,23 @@ int main()
 	/* set the new settings immediately */
 	tcsetattr(STDIN_FILENO,TCSANOW,&new_tio);
 
-	transmit(prompt, strlen(prompt));
-	transmit(" ", 1);
-	monExit = false;
-	do {
-		 c = getchar();
-		 if (c == EOF)
-			break;
-		 processChar(c);
-	} while (!monExit);
-	transmit(EOL, 1);
+	signal(SIGINT, interrupt);
+
+	hostTickStart();
+	eventOn(EV_INPUT, input, NULL);
+	eventOn(EV_TICK, tick, NULL);
+	eventOn(EV_TX, output, NULL);
+	eventIdle(waitEvents, NULL);
+
+	monInit(&ctx);
+#ifdef INCL_STORE
+	storeRestore(&ctx);
+#endif
+	transmit(&ctx, ctx.prompt, strlen(ctx.prompt));
+	transmit(&ctx, " ", 1);
+	eventRun(&ctx.monExit);
+	transmit(&ctx, EOL, 1);
+	txWrite(TX_SIZE);
 	
 	/* restore the former settings */
 	tcsetattr(STDIN_FILENO, TCSANOW, &old_tio);
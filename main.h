@@ -28,9 +28,43 @@
 #if !defined(_MAIN_H)
 #define _MAIN_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "token.h"
+
 #define EOL		"\n"
 
-extern void transmit(char *pData, unsigned size);
-#define transmitString(S)	transmit(S, strlen(S))
+typedef uintptr_t mword_t;	//!< Native memory word
+
+extern void transmit(mon_ctx_t* ctx, char *pData, unsigned size);
+#define transmitString(C, S)	transmit(C, S, strlen(S))
+
+extern unsigned long clockMicros();
+/**
+ * \brief The monitor's address space, memory commands access memory only
+ * through the pointer it returns. A target just casts the address, a host
+ * maps it onto whatever it simulates.
+ */
+extern void* memAddr(unsigned long addr, unsigned long len);
+/**
+ * \brief Flash pages for the settings store, STORE_PAGES of STORE_PAGE_SIZE
+ * bytes. Pages are read through the pointer. A write can only clear bits,
+ * as on flash, and erasing sets every byte to 0xFF.
+ */
+extern const unsigned char* flashPage(unsigned page);
+extern bool flashWrite(unsigned page, unsigned offset, const void* p, unsigned len);
+extern bool flashErase(unsigned page);
+/**
+ * \brief Call profSample() (prof.h) every 'us' microseconds from a timer
+ * interrupt, or stop if 'us' is 0.
+ */
+extern bool profTimer(unsigned long us);
+/**
+ * \brief Called by capture after each sample. The host steps its simulated
+ * sensor (host.h), a target can leave CAPTURE_STEP undefined.
+ */
+#define CAPTURE_STEP(p)	hostCaptureStep((const volatile void*)(p))
+extern void hostCaptureStep(const volatile void* p);
 
 #endif
@@ -0,0 +1,262 @@
+/**
+ * \file mem.c
+ * \brief Memory access commands: peek, poke, fill and copy.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "mem.h"
+#include "context.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+#define WORD_MASK	(sizeof(mword_t) - 1)
+
+/**
+ * \brief Make an error token and report it
+ * \returns 'ERR' token (must be freed)
+ */
+static token_t* argError(mon_ctx_t* ctx, char* owner)
+{
+	return emitError(ctx, tokenAlloc(ctx, owner), MSG_ARGUMENT);
+}
+
+/**
+ * \brief Translate the address and width of a peek or poke. Peripheral
+ * registers need a single naturally aligned access of the right width.
+ * \param args  Address token, then the width token if nArgs > w
+ * \param w  Index of the width token
+ * \param width  Set to the width in bytes, default is the size of a number
+ * \returns Pointer, or NULL if the width is not a number or the width or
+ * alignment is bad
+ */
+static volatile void* regAddr(token_t *args[], int nArgs, int w, int* width)
+{
+	unum_t addr = args[0]->v.d;
+	if ((nArgs > w) && (args[w]->t != NUM))
+		return NULL;
+	*width = (nArgs > w) ? args[w]->v.d : (int)sizeof(unum_t);
+	if ((*width != 1) && (*width != 2) && (*width != 4) && (*width != 8))
+		return NULL;
+	if ((*width > sizeof(unum_t)) || (addr & (*width - 1)))
+		return NULL;
+	return memAddr(addr, *width);
+}
+
+/**
+ * \brief Read memory
+ * \param args  Array of 'NUM' tokens: address and optional width 1, 2, 4
+ * or 8 bytes
+ * \param nArgs  Number of arguments, one or two
+ * \returns 'NUM' token containing the value (must be freed)
+ */
+token_t* cmd_peek(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	int width;
+	volatile void* p = regAddr(args, nArgs, 1, &width);
+
+	if ((nArgs > 2) || (p == NULL))
+		return argError(ctx, "cmd_peek");
+	token_t* r = tokenAlloc(ctx, "cmd_peek");
+	r->t = NUM;
+	if (width == 1)
+		r->v.d = *(volatile uint8_t*)p;
+	else if (width == 2)
+		r->v.d = *(volatile uint16_t*)p;
+#if NUM_BITS >= 32
+	else if (width == 4)
+		r->v.d = *(volatile uint32_t*)p;
+#endif
+#if NUM_BITS >= 64
+	else
+		r->v.d = *(volatile uint64_t*)p;
+#endif
+	return r;
+}
+
+/**
+ * \brief Write memory
+ * \param args  Array of 'NUM' tokens: address, value and optional width
+ * 1, 2, 4 or 8 bytes
+ * \param nArgs  Number of arguments, two or three
+ * \returns 'EMPTY' token (must be freed)
+ */
+token_t* cmd_poke(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	int width;
+	volatile void* p = regAddr(args, nArgs, 2, &width);
+	unum_t v = args[1]->v.d;
+
+	if ((nArgs > 3) || (p == NULL))
+		return argError(ctx, "cmd_poke");
+	if (width == 1)
+		*(volatile uint8_t*)p = v;
+	else if (width == 2)
+		*(volatile uint16_t*)p = v;
+#if NUM_BITS >= 32
+	else if (width == 4)
+		*(volatile uint32_t*)p = v;
+#endif
+#if NUM_BITS >= 64
+	else
+		*(volatile uint64_t*)p = v;
+#endif
+	token_t* r = tokenAlloc(ctx, "cmd_poke");
+	r->t = EMPTY;
+	return r;
+}
+
+/**
+ * \brief Fill memory with a byte, a word at a time where it is aligned
+ * \param args  Array of 'NUM' tokens: address, length in bytes and value
+ * 0 to 0xFF
+ * \param nArgs  Number of arguments, must be three
+ * \returns 'EMPTY' token (must be freed)
+ */
+token_t* cmd_fill(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	unum_t len = args[1]->v.d;
+	volatile uint8_t* p = memAddr((unum_t)args[0]->v.d, len);
+
+	if ((p == NULL) || ((unum_t)args[2]->v.d > 0xFF))
+		return argError(ctx, "cmd_fill");
+	uint8_t b = args[2]->v.d;
+	mword_t w = (mword_t)-1 / 0xFF * b;	// b in every byte
+	// bytes up to a word boundary, words (four at a time), then the rest
+	while ((len > 0) && ((uintptr_t)p & WORD_MASK)) {
+		*p++ = b;
+		len--;
+	}
+	volatile mword_t* wp = (volatile mword_t*)p;
+	unum_t n = len / sizeof(mword_t);
+	for (; n >= 4; n -= 4, wp += 4) {
+		wp[0] = w;
+		wp[1] = w;
+		wp[2] = w;
+		wp[3] = w;
+	}
+	while (n-- > 0)
+		*wp++ = w;
+	p = (volatile uint8_t*)wp;
+	for (len &= WORD_MASK; len > 0; len--)
+		*p++ = b;
+
+	token_t* r = tokenAlloc(ctx, "cmd_fill");
+	r->t = EMPTY;
+	return r;
+}
+
+/**
+ * \brief Copy memory forwards
+ * \param d  Destination
+ * \param s  Source
+ * \param len  Bytes to copy
+ */
+static void copyUp(volatile uint8_t* d, volatile uint8_t* s, unum_t len)
+{
+	if ((((uintptr_t)d ^ (uintptr_t)s) & WORD_MASK) == 0) {
+		while ((len > 0) && ((uintptr_t)d & WORD_MASK)) {
+			*d++ = *s++;
+			len--;
+		}
+		volatile mword_t* dw = (volatile mword_t*)d;
+		volatile mword_t* sw = (volatile mword_t*)s;
+		unum_t n = len / sizeof(mword_t);
+		for (; n >= 4; n -= 4, dw += 4, sw += 4) {
+			dw[0] = sw[0];
+			dw[1] = sw[1];
+			dw[2] = sw[2];
+			dw[3] = sw[3];
+		}
+		while (n-- > 0)
+			*dw++ = *sw++;
+		d = (volatile uint8_t*)dw;
+		s = (volatile uint8_t*)sw;
+		len &= WORD_MASK;
+	}
+	while (len-- > 0)
+		*d++ = *s++;
+}
+
+/**
+ * \brief Copy memory backwards, for overlapping regions with d above s
+ * \param d  Destination
+ * \param s  Source
+ * \param len  Bytes to copy
+ */
+static void copyDown(volatile uint8_t* d, volatile uint8_t* s, unum_t len)
+{
+	d += len;
+	s += len;
+	if ((((uintptr_t)d ^ (uintptr_t)s) & WORD_MASK) == 0) {
+		while ((len > 0) && ((uintptr_t)d & WORD_MASK)) {
+			*--d = *--s;
+			len--;
+		}
+		volatile mword_t* dw = (volatile mword_t*)d;
+		volatile mword_t* sw = (volatile mword_t*)s;
+		unum_t n = len / sizeof(mword_t);
+		for (; n >= 4; n -= 4) {
+			dw -= 4;
+			sw -= 4;
+			dw[3] = sw[3];
+			dw[2] = sw[2];
+			dw[1] = sw[1];
+			dw[0] = sw[0];
+		}
+		while (n-- > 0)
+			*--dw = *--sw;
+		d = (volatile uint8_t*)dw;
+		s = (volatile uint8_t*)sw;
+		len &= WORD_MASK;
+	}
+	while (len-- > 0)
+		*--d = *--s;
+}
+
+/**
+ * \brief Copy memory, the regions may overlap
+ * \param args  Array of 'NUM' tokens: destination, source and length in bytes
+ * \param nArgs  Number of arguments, must be three
+ * \returns 'EMPTY' token (must be freed)
+ */
+token_t* cmd_copy(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	unum_t len = args[2]->v.d;
+	volatile uint8_t* d = memAddr((unum_t)args[0]->v.d, len);
+	volatile uint8_t* s = memAddr((unum_t)args[1]->v.d, len);
+
+	if ((d == NULL) || (s == NULL))
+		return argError(ctx, "cmd_copy");
+	if ((d > s) && (d < s + len))
+		copyDown(d, s, len);
+	else
+		copyUp(d, s, len);
+	token_t* r = tokenAlloc(ctx, "cmd_copy");
+	r->t = EMPTY;
+	return r;
+}
@@ -0,0 +1,320 @@
+/**
+ * \file memtest.c
+ * \brief Word wide RAM test (March C- and walking ones).
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "memtest.h"
+#include "context.h"
+#include "monitor.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+#define FILL	0	//!< Element writes each word
+#define VERIFY	1	//!< Element reads each word
+#define UP		2	//!< Element reads then writes each word, ascending
+#define DOWN	3	//!< Element reads then writes each word, descending
+
+#define OK			-1L		//!< Element passed
+#define CANCELLED	-2L		//!< Element was cancelled
+
+/**
+ * \brief A March element
+ */
+typedef struct {
+	char op;  //!< FILL, VERIFY, UP or DOWN
+	bool rdInv;  //!< Expect the inverted background when reading
+	bool wrInv;  //!< Write the inverted background
+} element_t;
+
+/**
+ * \brief March C- : (w0) ^(r0,w1) ^(r1,w0) v(r0,w1) v(r1,w0) (r0)
+ */
+static const element_t marchC[] = {
+	{ FILL, false, false },
+	{ UP, false, true },
+	{ UP, true, false },
+	{ DOWN, false, true },
+	{ DOWN, true, false },
+	{ VERIFY, false, false }
+};
+#define ELEMENTS	(sizeof(marchC) / sizeof(element_t))
+
+/**
+ * Called after each element, BIG builds use it to inject faults.
+ */
+void (*memtestHook)(void) = NULL;
+
+/**
+ * \brief Write a value to each word
+ * \param p  First word
+ * \param n  Number of words
+ * \param wr  Value to write
+ * \returns n
+ */
+static unsigned long fillChunk(volatile mword_t* p, unsigned long n, mword_t wr)
+{
+	unsigned long i;
+	for (i=0; i+4<=n; i+=4) {
+		p[i] = wr;
+		p[i+1] = wr;
+		p[i+2] = wr;
+		p[i+3] = wr;
+	}
+	for (; i<n; i++)
+		p[i] = wr;
+	return n;
+}
+
+/**
+ * \brief Check each word holds a value
+ * \param p  First word
+ * \param n  Number of words
+ * \param rd  Expected value
+ * \returns index of first word that differs, n if none do
+ */
+static unsigned long verifyChunk(volatile mword_t* p, unsigned long n, mword_t rd)
+{
+	unsigned long i;
+	for (i=0; i+4<=n; i+=4) {
+		mword_t e0 = p[i] ^ rd;
+		mword_t e1 = p[i+1] ^ rd;
+		mword_t e2 = p[i+2] ^ rd;
+		mword_t e3 = p[i+3] ^ rd;
+		if (e0 | e1 | e2 | e3)
+			return i + (e0 ? 0 : e1 ? 1 : e2 ? 2 : 3);
+	}
+	for (; i<n; i++)
+		if (p[i] != rd)
+			return i;
+	return n;
+}
+
+/**
+ * \brief Read, check and write each word in ascending order
+ * \param p  First word
+ * \param n  Number of words
+ * \param rd  Expected value
+ * \param wr  Value to write
+ * \returns index of first word that differs, n if none do
+ */
+static unsigned long upChunk(volatile mword_t* p, unsigned long n, mword_t rd, mword_t wr)
+{
+	unsigned long i;
+	for (i=0; i+4<=n; i+=4) {
+		mword_t e0 = p[i] ^ rd;
+		p[i] = wr;
+		mword_t e1 = p[i+1] ^ rd;
+		p[i+1] = wr;
+		mword_t e2 = p[i+2] ^ rd;
+		p[i+2] = wr;
+		mword_t e3 = p[i+3] ^ rd;
+		p[i+3] = wr;
+		if (e0 | e1 | e2 | e3)
+			return i + (e0 ? 0 : e1 ? 1 : e2 ? 2 : 3);
+	}
+	for (; i<n; i++) {
+		mword_t e = p[i] ^ rd;
+		p[i] = wr;
+		if (e)
+			return i;
+	}
+	return n;
+}
+
+/**
+ * \brief Read, check and write each word in descending order
+ * \param p  First word
+ * \param n  Number of words
+ * \param rd  Expected value
+ * \param wr  Value to write
+ * \returns index of first word (in test order) that differs, n if none do
+ */
+static unsigned long downChunk(volatile mword_t* p, unsigned long n, mword_t rd, mword_t wr)
+{
+	unsigned long i;
+	for (i=n; i>=4; i-=4) {
+		mword_t e0 = p[i-1] ^ rd;
+		p[i-1] = wr;
+		mword_t e1 = p[i-2] ^ rd;
+		p[i-2] = wr;
+		mword_t e2 = p[i-3] ^ rd;
+		p[i-3] = wr;
+		mword_t e3 = p[i-4] ^ rd;
+		p[i-4] = wr;
+		if (e0 | e1 | e2 | e3)
+			return i - (e0 ? 1 : e1 ? 2 : e2 ? 3 : 4);
+	}
+	for (; i>0; i--) {
+		mword_t e = p[i-1] ^ rd;
+		p[i-1] = wr;
+		if (e)
+			return i-1;
+	}
+	return n;
+}
+
+/**
+ * \brief Apply one element to the whole region, a chunk at a time
+ * \param ctx  Monitor context, its monCancel stops the test
+ * \param p  First word
+ * \param n  Number of words
+ * \param op  FILL, VERIFY, UP or DOWN
+ * \param rd  Expected value
+ * \param wr  Value to write
+ * \returns index of first failing word, OK or CANCELLED
+ */
+static long element(mon_ctx_t* ctx, volatile mword_t* p, unsigned long n, int op, mword_t rd, mword_t wr)
+{
+	unsigned long done = 0;
+	while (done < n) {
+		unsigned long c = n - done;
+		unsigned long r;
+		if (c > MEMTEST_CHUNK)
+			c = MEMTEST_CHUNK;
+		if (ctx->monCancel)
+			return CANCELLED;
+		if (op == FILL)
+			r = fillChunk(p + done, c, wr);
+		else if (op == VERIFY)
+			r = verifyChunk(p + done, c, rd);
+		else if (op == UP)
+			r = upChunk(p + done, c, rd, wr);
+		else {
+			// descend through the chunks from the top
+			volatile mword_t* q = p + n - done - c;
+			r = downChunk(q, c, rd, wr);
+			if (r != c)
+				return (q - p) + r;
+		}
+		if (r != c)
+			return done + r;
+		done += c;
+	}
+	if (memtestHook)
+		memtestHook();
+	return OK;
+}
+
+/**
+ * \brief Test RAM with March C- and walking ones at native word width
+ * \param args  Array of 'NUM' tokens: address, length and optional
+ * background pattern
+ * \param nArgs  Number of arguments, two or three
+ * \returns 'EMPTY' token, or 'ERR' token if the test fails (must be freed)
+ * \note Clears then checks monCancel so the test can be stopped.
+ */
+token_t* cmd_memtest(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	unsigned long addr = (unum_t)args[0]->v.d;
+	unsigned long start = (addr + sizeof(mword_t) - 1) & ~(sizeof(mword_t) - 1);
+	unsigned long end = (addr + (unum_t)args[1]->v.d) & ~(sizeof(mword_t) - 1);
+	mword_t bg = (nArgs > 2) ? (mword_t)args[2]->v.d : 0;
+	volatile mword_t* p = NULL;
+	unsigned long n = 0;
+	unsigned passes = 0;
+	long bad = OK;
+	token_t* r = tokenAlloc(ctx, "cmd_memtest");
+
+	if ((nArgs <= 3) && (end > start) && ((nArgs < 3) || (args[2]->t == NUM))) {
+		n = (end - start) / sizeof(mword_t);
+		p = memAddr(start, end - start);
+	}
+	if (p == NULL) {
+		emitError(ctx, r, MSG_ARGUMENT);
+		return r;
+	}
+
+	ctx->monCancel = false;
+	unsigned long t0 = clockMicros();
+	for (int i=0; (i<ELEMENTS) && (bad == OK); i++, passes++)
+		bad = element(ctx, p, n, marchC[i].op,
+					  marchC[i].rdInv ? ~bg : bg, marchC[i].wrInv ? ~bg : bg);
+	for (int b=0; (b<sizeof(mword_t)*8) && (bad == OK); b++, passes+=2) {
+		mword_t one = (mword_t)1 << b;
+		bad = element(ctx, p, n, FILL, 0, one);
+		if (bad == OK)
+			bad = element(ctx, p, n, VERIFY, one, 0);
+	}
+	unsigned long t = clockMicros() - t0;
+
+	if (bad == OK) {
+		emitString(ctx, "memtest: ");
+		emitUnsigned(ctx, n * sizeof(mword_t), 0);
+		emitString(ctx, " bytes, ");
+		emitUnsigned(ctx, passes, 0);
+		emitString(ctx, " passes, ");
+		emitRate(ctx, (unsigned long long)n * sizeof(mword_t) * passes, t);
+		emitString(ctx, " bytes/s" EOL);
+		r->t = EMPTY;
+	} else if (bad == CANCELLED) {
+		emitError(ctx, r, MSG_CANCELLED);
+	} else {
+		r->t = ERR;
+		textCopy(r->v.s, MSG_MEMORY, MAX_STRING);
+		emitErrorOpen(ctx);
+		textEmit(ctx, MSG_MEMORY);
+		textEmit(ctx, MSG_AT);
+		emitHex(ctx, start + bad * sizeof(mword_t), true, 8);
+		emitErrorClose(ctx);
+	}
+	return r;
+}
+
+#ifdef BIG
+static unsigned long faultAddr;
+static unsigned char faultMask;
+
+/**
+ * \brief Force the faulty bit to one, simulating a stuck at one cell.
+ */
+static void stuckAtOne(void)
+{
+	volatile unsigned char* p = memAddr(faultAddr, 1);
+	if (p != NULL)
+		*p |= faultMask;
+}
+
+/**
+ * \brief Inject a stuck at one bit for memtest to find
+ * \param args  Array of 'NUM' tokens: address and bit number, a negative
+ * bit number removes the fault
+ * \param nArgs  Number of arguments, must be two
+ * \returns 'EMPTY' token (must be freed)
+ */
+token_t* cmd_memfault(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	faultAddr = (unum_t)args[0]->v.d;
+	faultMask = 1 << (args[1]->v.d & 7);
+	memtestHook = (args[1]->v.d < 0) ? NULL : stuckAtOne;
+	token_t* r = tokenAlloc(ctx, "cmd_memfault");
+	r->t = EMPTY;
+	return r;
+}
+#endif
@@ -28,9 +28,12 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "monitor.h"
 #include "token.h"
 #include "lexer.h"
 #include "process.h"
+#include "print.h"
+#include "emit.h"
 #include "main.h"
 
 #ifdef BIG
@@ -38,131 +41,508 @@
 #define LE  0x0A	//!< line end
 #define UP	0x15	//!< control u
 #define DN	0x04	//!< control d
+#define RS	0x12	//!< control r, reverse search
 #else
 #define BS	0x08	//!< erase last character, backspace on MCU's
 #define LE  0x0D	//!< line end
 #define UP	0x15	//!< control u
 #define DN	0x04	//!< control d
+#define RS	0x12	//!< control r, reverse search
 #endif
+#define LT	0x02	//!< control b, cursor left
+#define RT	0x06	//!< control f, cursor right
+#define HM	0x01	//!< control a, cursor to start of line
+#define EN	0x05	//!< control e, cursor to end of line
+#define DL	0x1F	//!< delete character at cursor, from ESC [ 3 ~
 
-static char buf[4][MAX_STRING];
-static unsigned bufIdx[4] = { 0, 0, 0, 0 };
-static unsigned curBuf = 0;
-static unsigned histBuf = 0;
-char prompt[20] = { '>', 0 };
-bool monExit;
- 
 /**
- * \brief Buffer index increment
- * \param bn  
+ * \brief Initialise a monitor context
+ * \param ctx  Context of a new session
  */
-void bufIdxInc(int bn)
+void monInit(mon_ctx_t* ctx)
 {
-	if ((bufIdx[bn] + 1) < MAX_STRING-2)
-		bufIdx[bn]++;
+	memset(ctx, 0, sizeof(mon_ctx_t));
+	ctx->prompt[0] = '>';
+	ctx->termAnsi = true;
+	ctx->outputDecimal = true;
 }
 
 /**
- * \brief Compose the current input line. Supports backspacing and copmmand history.
+ * \brief Find a history entry
+ * \param n  Entry number, 1 is the newest
+ * \returns Index in hist of the entry's length byte
+ */
+static unsigned histFind(mon_ctx_t* ctx, unsigned n)
+{
+	unsigned i = ctx->histTail;
+	for (unsigned j=n; j<ctx->histCount; j++)
+		i = (i + 1 + ctx->hist[i]) % HIST_SIZE;
+	return i;
+}
+
+/**
+ * \brief Copy a history entry out of the ring
+ * \param n  Entry number, 1 is the newest
+ * \param s  Buffer for the characters, at least MAX_STRING long
+ * \returns Length of the entry
+ */
+static unsigned histGet(mon_ctx_t* ctx, unsigned n, char* s)
+{
+	unsigned i = histFind(ctx, n);
+	unsigned len = ctx->hist[i];
+	for (unsigned j=0; j<len; j++) {
+		i = (i + 1) % HIST_SIZE;
+		s[j] = ctx->hist[i];
+	}
+	return len;
+}
+
+/**
+ * \brief Add the input line to the history unless it repeats the newest
+ */
+static void histAdd(mon_ctx_t* ctx)
+{
+	char s[MAX_STRING];
+
+	if ((ctx->lineLen == 0) || ((ctx->histCount > 0) && (histGet(ctx, 1, s) == ctx->lineLen)
+							&& !memcmp(s, ctx->line, ctx->lineLen)))
+		return;
+	// drop oldest entries until the line fits
+	while (HIST_SIZE - ctx->histUsed < ctx->lineLen + 1) {
+		ctx->histUsed -= 1 + ctx->hist[ctx->histTail];
+		ctx->histTail = (ctx->histTail + 1 + ctx->hist[ctx->histTail]) % HIST_SIZE;
+		ctx->histCount--;
+	}
+	unsigned i = (ctx->histTail + ctx->histUsed) % HIST_SIZE;
+	ctx->hist[i] = ctx->lineLen;
+	for (unsigned j=0; j<ctx->lineLen; j++) {
+		i = (i + 1) % HIST_SIZE;
+		ctx->hist[i] = ctx->line[j];
+	}
+	ctx->histUsed += ctx->lineLen + 1;
+	ctx->histCount++;
+}
+
+/**
+ * \brief Search the history for an entry containing pat
+ * \param n  Entry to start at, 1 is the newest
+ * \returns Entry number of the match, 0 if there isn't one
+ */
+static unsigned histSearch(mon_ctx_t* ctx, unsigned n)
+{
+	char s[MAX_STRING];
+
+	for (; n<=ctx->histCount; n++) {
+		unsigned len = histGet(ctx, n, s);
+		for (unsigned i=0; i+ctx->patLen<=len; i++)
+			if (!memcmp(&s[i], ctx->pat, ctx->patLen))
+				return n;
+	}
+	return 0;
+}
+
+/**
+ * \brief Send an ANSI cursor movement sequence
+ * \param n  Number of characters to move
+ * \param dir  'C' for right, 'D' for left
+ */
+static void moveAnsi(mon_ctx_t* ctx, unsigned n, char dir)
+{
+	emitString(ctx, "\x1B[");
+	emitUnsigned(ctx, n, 0);
+	emitStr(ctx, &dir, 1);
+}
+
+/**
+ * \brief Move the console cursor left, with backspaces or, if shorter,
+ * an ANSI sequence.
+ * \param n  Number of characters to move
+ */
+static void moveLeft(mon_ctx_t* ctx, unsigned n)
+{
+	if (ctx->termAnsi && (n > 3)) {
+		moveAnsi(ctx, n, 'D');
+	} else {
+		for (unsigned i=0; i<n; i++)
+			transmit(ctx, "\x08", 1);
+	}
+}
+
+/**
+ * \brief Move the console cursor within the displayed text, moving right
+ * rewrites the characters passed over unless an ANSI sequence is shorter.
+ * \param s  Text displayed
+ * \param from  Position of console cursor
+ * \param to  New position of console cursor
+ */
+static void moveCursor(mon_ctx_t* ctx, char* s, unsigned from, unsigned to)
+{
+	if (to < from)
+		moveLeft(ctx, from - to);
+	else if (ctx->termAnsi && (to - from > 4))
+		moveAnsi(ctx, to - from, 'C');
+	else
+		transmit(ctx, &s[from], to - from);
+}
+
+/**
+ * \brief Change the text on the console, sending only the changed suffix.
+ * \param old  Text displayed now
+ * \param oldLen  Its length
+ * \param oldCur  Position of the console cursor in it
+ * \param now  Text to display
+ * \param nowLen  Its length
+ * \param nowCur  Position to leave the console cursor at
+ */
+static void update(mon_ctx_t* ctx, char* old, unsigned oldLen, unsigned oldCur,
+				   char* now, unsigned nowLen, unsigned nowCur)
+{
+	unsigned same = 0;
+	while ((same < oldLen) && (same < nowLen) && (old[same] == now[same]))
+		same++;
+	unsigned tail = oldLen - same;	// old characters after those that are the same
+	if (ctx->termAnsi && (oldLen == nowLen + 1) && (tail > 4)
+		&& !memcmp(&old[same+1], &now[same], tail - 1)) {
+		// one character deleted, delete it on the console
+		moveCursor(ctx, old, oldCur, same);
+		transmit(ctx, "\x1B[P", 3);
+		oldCur = same;
+	} else if (ctx->termAnsi && (nowLen == oldLen + 1) && (tail > 4)
+		&& !memcmp(&old[same], &now[same+1], tail)) {
+		// one character inserted, insert it on the console
+		moveCursor(ctx, old, oldCur, same);
+		transmit(ctx, "\x1B[@", 3);
+		transmit(ctx, &now[same], 1);
+		oldCur = same + 1;
+	} else if ((same < oldLen) || (same < nowLen)) {
+		moveCursor(ctx, old, oldCur, same);
+		transmit(ctx, &now[same], nowLen - same);
+		oldCur = nowLen;
+		if (oldLen > nowLen) {
+			// erase what is left of the old text
+			unsigned n = oldLen - nowLen;
+			if (ctx->termAnsi && (n > 1)) {
+				transmit(ctx, "\x1B[K", 3);
+			} else {
+				for (unsigned i=0; i<n; i++)
+					transmit(ctx, " ", 1);
+				moveLeft(ctx, n);
+			}
+		}
+	}
+	moveCursor(ctx, now, oldCur, nowCur);
+}
+
+/**
+ * \brief Text displayed during a reverse search, '[pattern] match'
+ * \param s  Buffer, at least 2 * MAX_STRING + 3 long
+ * \returns Length of text
+ */
+static unsigned searchText(mon_ctx_t* ctx, char* s)
+{
+	s[0] = '[';
+	memcpy(&s[1], ctx->pat, ctx->patLen);
+	s[ctx->patLen + 1] = ']';
+	s[ctx->patLen + 2] = ' ';
+	memcpy(&s[ctx->patLen + 3], ctx->line, ctx->lineLen);
+	return ctx->patLen + 3 + ctx->lineLen;
+}
+
+/**
+ * \brief Handle a character during a reverse search, ^R finds the next
+ * older match, other control characters end the search.
+ * \param c latest input character
+ * \returns true if the character was used by the search
+ */
+static bool search(mon_ctx_t* ctx, char c)
+{
+	char old[2 * MAX_STRING + 3];
+	char now[2 * MAX_STRING + 3];
+	unsigned oldLen = searchText(ctx, old);
+	unsigned n = ctx->found;
+
+	if (c == RS) {
+		n = histSearch(ctx, ctx->found + 1);
+	} else if (c == BS) {
+		if (ctx->patLen > 0)
+			ctx->patLen--;
+		if (ctx->patLen > 0)
+			n = histSearch(ctx, 1);
+	} else if ((c >= ' ') && (c < 0x7F)) {
+		if (ctx->patLen < MAX_STRING - 2)
+			ctx->pat[ctx->patLen++] = c;
+		n = histSearch(ctx, ctx->found ? ctx->found : 1);
+	} else {
+		// leave the match in the input line
+		ctx->searching = false;
+		update(ctx, old, oldLen, oldLen, ctx->line, ctx->lineLen, ctx->lineLen);
+		ctx->cursor = ctx->lineLen;
+		ctx->histPos = ctx->found;
+		return false;
+	}
+	if (n != 0) {
+		ctx->found = n;
+		ctx->lineLen = histGet(ctx, n, ctx->line);
+	}
+	unsigned nowLen = searchText(ctx, now);
+	update(ctx, old, oldLen, oldLen, now, nowLen, nowLen);
+	return true;
+}
+
+/**
+ * \brief Replace the input line with a history entry
+ * \param n  Entry number, 1 is the newest, 0 for an empty line
+ */
+static void recall(mon_ctx_t* ctx, unsigned n)
+{
+	char s[MAX_STRING];
+	unsigned len = 0;
+
+	if (n > 0)
+		len = histGet(ctx, n, s);
+	update(ctx, ctx->line, ctx->lineLen, ctx->cursor, s, len, len);
+	memcpy(ctx->line, s, len);
+	ctx->lineLen = len;
+	ctx->cursor = len;
+	ctx->histPos = n;
+}
+
+/**
+ * \brief Compose the current input line. Supports backspacing, command
+ * history and reverse search.
  * @param c latest input character
  */
-void readLine(char c)
+static void editLine(mon_ctx_t* ctx, char c)
 {
+	if (ctx->searching && search(ctx, c))
+		return;
 	if (c == LE) {  // Line End
-		transmitString(EOL);
-		buf[curBuf][bufIdx[curBuf]++] = 0;  // mark end of string
-		buf[curBuf][bufIdx[curBuf]] = 0;  // eval looks past end, so mark it again
-		token_t* rslt = eval(buf[curBuf]);
+		transmitString(ctx, EOL);
+		ctx->line[ctx->lineLen] = 0;  // mark end of string
+		ctx->line[ctx->lineLen+1] = 0;  // eval looks past end, so mark it again
+#ifdef INCL_STREAM
+		token_t* rslt = evalLexed(ctx, &ctx->line[ctx->lexedTo], ctx->lexed, ctx->numLexed);
+		ctx->numLexed = 0;
+		ctx->lexedTo = 0;
+#else
+		token_t* rslt = eval(ctx, ctx->line);
+#endif
 		if (rslt != NULL) {
 			// Print result of eval (maybe)
 			if ((rslt->t != EMPTY) && (rslt->t != ERR)) {
-				char *s = tokenGetText(rslt);
-				transmitString(s);
-				transmitString(EOL);
+				emitToken(ctx, rslt);
+				emitString(ctx, EOL);
 			}
-			tokenFree(rslt);
+			tokenFree(ctx, rslt);
 		}
 		// If not done print a new prompt
-		if (!monExit) {
-			transmit(prompt, strlen(prompt));
-			transmit(" ", 1);
-		}
-		curBuf = (curBuf + 1) & 3;
-		histBuf = curBuf;
-		bufIdx[curBuf] = 0;
-	} else if (c == BS) {  // Backspace
-		if (bufIdx[curBuf] > 0) {
-			transmit("\x08 \x08", 3);
-			bufIdx[curBuf]--;
+		if (!ctx->monExit) {
+			transmit(ctx, ctx->prompt, strlen(ctx->prompt));
+			transmit(ctx, " ", 1);
 		}
+		histAdd(ctx);
+		ctx->histPos = 0;
+		ctx->lineLen = 0;
+		ctx->cursor = 0;
 	} else if (c == UP) {
-		histBuf = (histBuf - 1) & 3;
-		if (histBuf != curBuf) {
-			// Erase current input from console
-			for (int i=0; i<bufIdx[curBuf]; i++)
-				transmit("\x08 \x08", 3);
-			// copy history into current
-			strcpy(buf[curBuf], buf[histBuf]);
-			bufIdx[curBuf] = bufIdx[histBuf]-1;
-			// Display new input on console
-			for (int i=0; i<bufIdx[curBuf]; i++)
-				transmit(&buf[curBuf][i], 1);
-		} else
-			histBuf = (histBuf + 1) & 3;
+		if (ctx->histPos < ctx->histCount)
+			recall(ctx, ctx->histPos + 1);
 	} else if (c == DN) {
-		histBuf = (histBuf + 1) & 3;
-		if (histBuf != curBuf) {
-			// Erase current input
-			for (int i=0; i<bufIdx[curBuf]; i++)
-				transmit("\x08 \x08", 3);
-			strcpy(buf[curBuf], buf[histBuf]);
-			bufIdx[curBuf] = bufIdx[histBuf]-1;
-			for (int i=0; i<bufIdx[curBuf]; i++)
-				transmit(&buf[curBuf][i], 1);
-		} else {
-			for (int i=0; i<strlen(buf[curBuf]); i++)
-				transmit("\x08 \x08", 3);
-			bufIdx[curBuf] = 0;
-		}
+		if (ctx->histPos > 0)
+			recall(ctx, ctx->histPos - 1);
+		else
+			recall(ctx, 0);
+	} else if (c == RS) {
+		char s[MAX_STRING + 3];
+		ctx->searching = true;
+		ctx->patLen = 0;
+		ctx->found = 0;
+		unsigned len = searchText(ctx, s);
+		update(ctx, ctx->line, ctx->lineLen, ctx->cursor, s, len, len);
 	} else {
-		buf[curBuf][bufIdx[curBuf]] = c;
-		bufIdxInc(curBuf);
-		transmit(&c, 1);
+		char old[MAX_STRING];
+		unsigned oldLen = ctx->lineLen;
+		unsigned oldCur = ctx->cursor;
+		memcpy(old, ctx->line, ctx->lineLen);
+		if (c == BS) {  // Backspace
+			if (ctx->cursor > 0) {
+				memmove(&ctx->line[ctx->cursor-1], &ctx->line[ctx->cursor], ctx->lineLen - ctx->cursor);
+				ctx->cursor--;
+				ctx->lineLen--;
+			}
+		} else if (c == DL) {
+			if (ctx->cursor < ctx->lineLen) {
+				memmove(&ctx->line[ctx->cursor], &ctx->line[ctx->cursor+1], ctx->lineLen - ctx->cursor - 1);
+				ctx->lineLen--;
+			}
+		} else if (c == LT) {
+			if (ctx->cursor > 0)
+				ctx->cursor--;
+		} else if (c == RT) {
+			if (ctx->cursor < ctx->lineLen)
+				ctx->cursor++;
+		} else if (c == HM) {
+			ctx->cursor = 0;
+		} else if (c == EN) {
+			ctx->cursor = ctx->lineLen;
+		} else if (ctx->lineLen < MAX_STRING-2) {  // Insert
+			memmove(&ctx->line[ctx->cursor+1], &ctx->line[ctx->cursor], ctx->lineLen - ctx->cursor);
+			ctx->line[ctx->cursor++] = c;
+			ctx->lineLen++;
+		}
+		update(ctx, old, oldLen, oldCur, ctx->line, ctx->lineLen, ctx->cursor);
+	}
+}
+
+#ifdef INCL_STREAM
+/**
+ * \brief Lex the input line as it is typed, so only its last token is
+ * left to lex when it ends. Tokens are lexed up to the last separator
+ * (space, comma or bracket) outside a string, where a token can't go on
+ * into the characters still to come. Nothing after an '=' expression is
+ * lexed until the line ends. Editing text that has been lexed rolls back
+ * the tokens lexed from it.
+ * \param old  The line before the last character
+ * \param oldLen  Its length
+ */
+static void streamLex(mon_ctx_t* ctx, char* old, unsigned oldLen)
+{
+	unsigned same = 0;
+	while ((same < oldLen) && (same < ctx->lineLen) && (old[same] == ctx->line[same]))
+		same++;
+	if (ctx->lexedTo > same) {
+		while ((ctx->numLexed > 0) && (ctx->lexedEnd[ctx->numLexed - 1] > same))
+			tokenFree(ctx, ctx->lexed[--ctx->numLexed]);
+		ctx->lexedTo = (ctx->numLexed > 0) ? ctx->lexedEnd[ctx->numLexed - 1] : 0;
+	}
+	if (ctx->searching)
+		return;
+
+	// find the last separator outside a string
+	unsigned end = 0;
+	bool inString = false;
+	for (unsigned i=ctx->lexedTo; i<ctx->lineLen; i++) {
+		char c = ctx->line[i];
+		if (inString) {
+			if (c == '\\')
+				i++;
+			else if (c == '"')
+				inString = false;
+		} else if (c == '"')
+			inString = true;
+		else if (c == '=')
+			break;
+		else if ((c == ' ') || (c == ',') || (c == '(') || (c == ')'))
+			end = i + 1;
+	}
+	if (end == 0)
+		return;
+
+	// lex up to the separator, keeping NEST_TOKENS free for watches
+	char save[2] = { ctx->line[end], ctx->line[end + 1] };
+	ctx->line[end] = ctx->line[end + 1] = 0;
+	int n = ctx->numLexed;
+	bool done = false;
+	if (lexerStart(ctx, &ctx->line[ctx->lexedTo])) {
+		while (!done && (n < MAX_ARGS - 1) && (tokensFree(ctx) > NEST_TOKENS)) {
+			token_t* t = lexer(ctx);
+			if (t->t == END) {
+				tokenFree(ctx, t);
+				done = true;
+			} else {
+				ctx->lexedEnd[n] = end;
+				ctx->lexed[n++] = t;
+			}
+		}
+		if (!done) {
+			// out of room, leave this part for the end of the line
+			while (n > ctx->numLexed)
+				tokenFree(ctx, ctx->lexed[--n]);
+		} else
+			ctx->lexedTo = end;
+		lexerClose(ctx);
 	}
+	ctx->numLexed = n;
+	ctx->line[end] = save[0];
+	ctx->line[end + 1] = save[1];
+}
+#endif
+
+/**
+ * \brief Compose the current input line, lexing it as it is typed when
+ * INCL_STREAM is defined.
+ * @param c latest input character
+ */
+void readLine(mon_ctx_t* ctx, char c)
+{
+#ifdef INCL_STREAM
+	if (c != LE) {
+		char old[MAX_STRING];
+		unsigned oldLen = ctx->lineLen;
+		memcpy(old, ctx->line, oldLen);
+		editLine(ctx, c);
+		streamLex(ctx, old, oldLen);
+		return;
+	}
+#endif
+	editLine(ctx, c);
 }
 
 /**
  * \brief Process input character.
- * Converts up and down arrow keys into UP and DN characters.
+ * Converts arrow, home, end and delete keys into UP, DN, LT, RT, HM, EN
+ * and DL characters.
+ * \param ctx  Monitor context of the session.
  * \param c  The input character.
  */
-void processChar(char c)
+void processChar(mon_ctx_t* ctx, char c)
 {
-	static int state = 0;
+	int state = ctx->escState;
 
 	if (state == 0) {
 		if (c == 0x1B) {
 			state = 1;
 		} else {
-			readLine(c);
+			readLine(ctx, c);
 		}
 	} else if (state == 1) {
 		if (c == 0x5B) {
 			state = 2;
 		} else {
-			readLine(0x1B);
+			readLine(ctx, 0x1B);
 			state = 0;
 		}
-	} else /* state == 2 */ {
+	} else if (state == 2) {
+		state = 0;
 		if (c == 0x41) {
-			readLine(UP);
+			readLine(ctx, UP);
 		} else if (c == 0x42) {
-			readLine(DN);
+			readLine(ctx, DN);
+		} else if (c == 0x43) {
+			readLine(ctx, RT);
+		} else if (c == 0x44) {
+			readLine(ctx, LT);
+		} else if (c == 0x48) {
+			readLine(ctx, HM);
+		} else if (c == 0x46) {
+			readLine(ctx, EN);
+		} else if (c == 0x33) {
+			state = 3;
+		} else {
+			readLine(ctx, 0x1B);
+			readLine(ctx, 0x5B);
+			readLine(ctx, c);
+		}
+	} else /* state == 3, ESC [ 3 */ {
+		if (c == 0x7E) {
+			readLine(ctx, DL);
 		} else {
-			readLine(0x1B);
-			readLine(0x5B);
-			readLine(c);
+			readLine(ctx, 0x1B);
+			readLine(ctx, 0x5B);
+			readLine(ctx, 0x33);
+			readLine(ctx, c);
 		}
 		state = 0;
 	}
+	ctx->escState = state;
 }
@@ -30,9 +30,9 @@
 
 #include <stdbool.h>
 
-extern char prompt[20];
-extern bool monExit;
+#include "context.h"
 
-extern void processChar(char c);
+extern void monInit(mon_ctx_t* ctx);
+extern void processChar(mon_ctx_t* ctx, char c);
 
 #endif
@@ -0,0 +1,77 @@
+/**
+ * \file pgm.c
+ * \brief Read only data kept in program memory.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pgm.h"
+
+/**
+ * \brief Length of a string in program memory
+ * \param s  The string
+ * \param max  Size of the array holding it, which it may fill without a
+ * terminating NUL
+ * \returns Its length
+ */
+unsigned pgmStrlen(const char* s, unsigned max)
+{
+	unsigned n = 0;
+	while ((n < max) && (pgmByte(s + n) != 0))
+		n++;
+	return n;
+}
+
+/**
+ * \brief Compare a string in RAM with one in program memory
+ * \param ram  String in RAM
+ * \param s  String in program memory
+ * \param max  Size of the array holding s
+ * \returns 0 if they are equal, as strcmp()
+ */
+int pgmStrcmp(const char* ram, const char* s, unsigned max)
+{
+	for (unsigned i=0; i<max; i++) {
+		char c = pgmByte(s + i);
+		if (ram[i] != c)
+			return (unsigned char)ram[i] - (unsigned char)c;
+		if (c == 0)
+			return 0;
+	}
+	return (unsigned char)ram[max];
+}
+
+/**
+ * \brief Copy a string from program memory into RAM
+ * \param dst  Destination
+ * \param s  String in program memory
+ * \param size  Size of dst, the copy is cut to fit and always terminated
+ * \returns dst
+ */
+char* pgmStrcpy(char* dst, const char* s, unsigned size)
+{
+	unsigned n = pgmStrlen(s, size - 1);
+	pgmCopy(dst, s, n);
+	dst[n] = 0;
+	return dst;
+}
@@ -0,0 +1,63 @@
+/**
+ * \file pgm.h
+ * \brief Read only data kept in program memory.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_PGM_H)
+#define _PGM_H
+
+#include <string.h>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+
+#define PGM_SPACE			PROGMEM		//!< Place a const object in flash
+#define PGM_STR(s)			PSTR(s)		//!< A string literal in flash
+#define pgmByte(p)			pgm_read_byte(p)
+#define pgmCopy(d, s, n)	memcpy_P(d, s, n)
+
+#else
+/*
+ * Von Neumann targets read flash like RAM. The host build counts each
+ * access, so pgmReads shows the cost of a path that an AVR would pay
+ * in pgm_read_* calls.
+ */
+#define PGM_SPACE
+#define PGM_STR(s)			(s)
+#if defined(PGM_COUNT)
+extern unsigned long pgmReads;  //!< Accesses to program memory data
+#define pgmByte(p)			(pgmReads++, *(const char*)(p))
+#define pgmCopy(d, s, n)	(pgmReads++, memcpy(d, s, n))
+#else
+#define pgmByte(p)			(*(const char*)(p))
+#define pgmCopy(d, s, n)	memcpy(d, s, n)
+#endif
+#endif
+
+extern unsigned pgmStrlen(const char* s, unsigned max);
+extern int pgmStrcmp(const char* ram, const char* s, unsigned max);
+extern char* pgmStrcpy(char* dst, const char* s, unsigned size);
+
+#endif
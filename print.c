@@ -26,81 +26,142 @@
  */
 
 #include "print.h"
+#include "prof.h"
 
-#define INT_DIGITS 11		/* enough for 32 bit integer */
+/**
+ * \brief Put the decimal digits of a number before p.
+ * \param p Where the last digit goes.
+ * \param u Number.
+ * \result first digit.
+ */
+static char* digits(char* p, unum_t u)
+{
+#if NUM_BITS > 32
+	// Nine digits at a time so most of the divisions are 32 bit, 32 bit
+	// MCUs have no 64 bit divide instruction
+	while (u > UINT32_MAX) {
+		uint32_t low = u % 1000000000;
+		u /= 1000000000;
+		for (int j=0; j<9; j++) {
+			*--p = '0' + (low % 10);
+			low /= 10;
+		}
+	}
+	uint32_t v = u;
+#else
+	unum_t v = u;
+#endif
+	do {
+		*--p = '0' + (v % 10);
+		v /= 10;
+	} while (v != 0);
+	return p;
+}
 
-static char buf[INT_DIGITS + 2];
+/**
+ * \brief Pad a number to a width.
+ * \param buf Buffer holding the number.
+ * \param p First character of the number.
+ * \param width Minimum width, at most FORMAT_LEN - 3.
+ * \param c Padding character.
+ * \result first character.
+ */
+static char* pad(char* buf, char* p, unsigned width, char c)
+{
+	char* first = FORMAT_END(buf) - ((width < FORMAT_LEN - 3) ? width : FORMAT_LEN - 3);
+	while (p > first)
+		*--p = c;
+	return p;
+}
 
 /**
  * \brief Format Decimal Number (base 10)
+ * \param buf Buffer of FORMAT_LEN characters, the number ends at
+ * FORMAT_END(buf).
  * \param i Number to format.
  * \param width Minimum width of result (pad with leading blanks).
- * \result string containing formatted number, must be used before
- * next 'formatNum' call.
+ * \result first character of the number.
  */
-char* formatDecimal(int i, unsigned width)
+char* formatDecimal(char* buf, num_t i, unsigned width)
 {
-	char *p = buf + INT_DIGITS + 1;	/* points to terminating '\0' */
+	PROF_ENTER(PROF_FORMAT, p0);
+	char *p = FORMAT_END(buf);
 	*p = '\000';
 
-	if (i >= 0) {
-		do {
-			*--p = '0' + (i % 10);
-			i /= 10;
-		} while (i != 0);
-	} else {			/* i < 0 */
-		do {
-			*--p = '0' - (i % 10);
-			i /= 10;
-		} while (i != 0);
+	// negate unsigned, -NUM_MAX-1 has no signed magnitude
+	p = digits(p, (i < 0) ? 0 - (unum_t)i : (unum_t)i);
+	if (i < 0)
 		*--p = '-';
-	}
-	for (int j=(buf+INT_DIGITS+1)-p; j<width; j++)
-		*--p = ' ';
+	p = pad(buf, p, width, ' ');
+	PROF_LEAVE(p0);
+	return p;
+}
+
+/**
+ * \brief Format Unsigned Decimal Number (base 10)
+ * \param buf Buffer of FORMAT_LEN characters, the number ends at
+ * FORMAT_END(buf).
+ * \param i Number to format.
+ * \param width Minimum width of result (pad with leading blanks).
+ * \result first character of the number.
+ */
+char* formatUnsigned(char* buf, unsigned long i, unsigned width)
+{
+	PROF_ENTER(PROF_FORMAT, p0);
+	char *p = FORMAT_END(buf);
+	*p = '\000';
+	do {
+		*--p = '0' + (i % 10);
+		i /= 10;
+	} while (i != 0);
+	p = pad(buf, p, width, ' ');
+	PROF_LEAVE(p0);
 	return p;
 }
 
 /**
  * Format Hexadecimal Number (base 16)
+ * \param buf Buffer of FORMAT_LEN characters, the number ends at
+ * FORMAT_END(buf).
  * \param i Number to format.
  * \param prefix Set true to add '0x' prefix to result.
  * \param width minimum width of result (pad with '0's after prefix)
- * \result string containing formatted number, must be used before
- * next 'formatNum' call.
+ * \result first character of the number.
  */
-char* formatHex(unsigned i, bool prefix, unsigned width)
+char* formatHex(char* buf, unum_t i, bool prefix, unsigned width)
 {
-	char *p = buf + INT_DIGITS + 1;	/* points to terminating '\0' */
+	PROF_ENTER(PROF_FORMAT, p0);
+	char *p = FORMAT_END(buf);
 	*p = '\000';
 	do {
-		if ((i % 16) < 10)
-			*--p = '0' + (i % 16);
+		if ((i & 0xF) < 10)
+			*--p = '0' + (i & 0xF);
 		else
-			*--p = 'A' + (i % 16) - 10;
-		i /= 16;
+			*--p = 'A' + (i & 0xF) - 10;
+		i >>= 4;
 	} while (i != 0);
-	for (int j=(buf+INT_DIGITS+1)-p; j<width; j++)
-		*--p = '0';
+	p = pad(buf, p, width, '0');
 	if (prefix) {
 		*--p = 'x';
 		*--p = '0';
 	}
+	PROF_LEAVE(p0);
 	return p;
 }
 
 /**
  * Format Number
+ * \param buf Buffer of FORMAT_LEN characters, the number ends at
+ * FORMAT_END(buf).
  * \param i number to format.
  * \param outputDecimal true for decimal otherwise hexadecimal.
- * \result string containing formatted number, must be used before
- * next 'formatNum' call.
+ * \result first character of the number.
  * \note Number will not be padded and hex numbers will be prefixed
  * with '0x'.
  */
-char* formatNum(int i, bool outputDecimal)
+char* formatNum(char* buf, num_t i, bool outputDecimal)
 {
 	if (outputDecimal)
-		return formatDecimal(i, 0);
-	return formatHex((unsigned)i, true, 0);
+		return formatDecimal(buf, i, 0);
+	return formatHex(buf, (unum_t)i, true, 0);
 }
-
@@ -30,9 +30,21 @@
 
 #include <stdbool.h>
 
-extern char* formatDecimal(int i, unsigned width);
-extern char* formatHex(unsigned i, bool prefix, unsigned width);
+#include "token.h"
 
-extern char* formatNum(int n, bool outputDecimal);
+/**
+ * Size of the buffer the format functions are given, enough for a 64 bit
+ * number with a sign or prefix. They write the number backwards from
+ * FORMAT_END(buf) and return its first character, so the caller has its
+ * length without strlen and no two calls share a static buffer.
+ */
+#define FORMAT_LEN		24
+#define FORMAT_END(buf)	(&(buf)[FORMAT_LEN - 1])
+
+extern char* formatDecimal(char* buf, num_t i, unsigned width);
+extern char* formatUnsigned(char* buf, unsigned long i, unsigned width);
+extern char* formatHex(char* buf, unum_t i, bool prefix, unsigned width);
+
+extern char* formatNum(char* buf, num_t n, bool outputDecimal);
 
 #endif
@@ -29,9 +29,16 @@
 #include <string.h>
 
 #include "process.h"
+#include "context.h"
 #include "lexer.h"
 #include "token.h"
 #include "commands.h"
+#include "timecmd.h"
+#include "expr.h"
+#include "prof.h"
+#include "trace.h"
+#include "emit.h"
+#include "text.h"
 #include "main.h"
 
 #if 0
@@ -42,7 +49,6 @@
 #endif
 
 #ifdef INCL_REG
-static token_t* regs[NUM_REGS];
 static token_t emptyReg = { EMPTY, { "" } };
 
 /**
@@ -50,13 +56,14 @@ static token_t emptyReg = { EMPTY, { "" } };
  * \param reg  Register name ('a' to 'h')
  * \param t    Token to be copied into register
  */
-void setReg(char reg, token_t* t)
+void setReg(mon_ctx_t* ctx, char reg, token_t* t)
 {
 	int regNum = reg - 'a';
+	TRACE(TRACE_SET_REG, (t->t << 8) | (unsigned char)reg);
 	if ((regNum >= 0) && (regNum < NUM_REGS)) {
-		if (regs[regNum] != NULL)
-			tokenFree(regs[regNum]);
-		regs[regNum] = tokenDup(t, "setReg");
+		if (ctx->regs[regNum] != NULL)
+			tokenFree(ctx, ctx->regs[regNum]);
+		ctx->regs[regNum] = tokenDup(ctx, t, "setReg");
 	}
 }
 
@@ -65,106 +72,226 @@ void setReg(char reg, token_t* t)
  * \param reg  Register name ('a' to 'h')
  * \returns token *DO NOT FREE*
  */
-token_t* getReg(char reg)
+token_t* getReg(mon_ctx_t* ctx, char reg)
 {
 	int regNum = reg - 'a';
 	if ((regNum < 0) || (regNum >= NUM_REGS)) {
-		transmitString("# Register '");
-		transmit(&reg, 1);
-		transmitString("' out of range #" EOL);
+		emitErrorOpen(ctx);
+		textEmit(ctx, MSG_REGISTER);
+		transmit(ctx, &reg, 1);
+		textEmit(ctx, MSG_REG_RANGE);
+		emitErrorClose(ctx);
 		return &emptyReg;
 	}
-	if (regs[regNum] == NULL) {
-		transmitString("# Register '");
-		transmit(&reg, 1);
-		transmitString("' undefined #" EOL);
+	if (ctx->regs[regNum] == NULL) {
+		emitErrorOpen(ctx);
+		textEmit(ctx, MSG_REGISTER);
+		transmit(ctx, &reg, 1);
+		textEmit(ctx, MSG_REG_UNDEFINED);
+		emitErrorClose(ctx);
 		return &emptyReg;
 	}
-	return regs[regNum];
+	return ctx->regs[regNum];
 }
 #endif
 
 /**
- * Evaluate Command
- * \param input  String containing command
- * \return token Result of evaluation (STR, NUM, EMPTY) *MUST BE FREED*
+ * Replace a command nested too deep with an error
+ * \param tokens  Array to hold the ERR token
+ * \return 1, the number of tokens
  */
-token_t* eval(char *input)
+static int nestError(mon_ctx_t* ctx, token_t* tokens[])
 {
-	int numTokens;
-	token_t* tokens[MAX_ARGS];
-	token_t* result;
-	int exeCount = 0;
+	tokens[0] = tokenAlloc(ctx, "nest");
+	tokens[0]->t = ERR;
+	textCopy(tokens[0]->v.s, MSG_NEST, MAX_STRING);
+	return 1;
+}
 
-	DEBUG(printf("eval \"%s\" begin\n", input);)
-	lexerStart(input);
-	token_t* token;
-	numTokens = 0;
+/**
+ * Split a command string into tokens
+ * \param input  String containing command
+ * \param tokens  Array of MAX_ARGS token pointers to fill, the END
+ * token is not included and lexing stops after an EXIT token
+ * \param numTokens  Tokens already in the array, lexed from the start of
+ * the command as it was typed, fewer than MAX_ARGS
+ * \return Number of tokens, the tokens *MUST BE FREED*
+ */
+int tokenize(mon_ctx_t* ctx, char *input, token_t* tokens[], int numTokens)
+{
+	DEBUG(printf("tokenize \"%s\"\n", input);)
+#ifdef INCL_EXIT
+	if ((numTokens > 0) && (tokens[numTokens-1]->t == EXIT))
+		return numTokens;
+#endif
+	if (!lexerStart(ctx, input))
+		return numTokens + nestError(ctx, &tokens[numTokens]);
 	do {
-		token = lexer();
+		TIME_BEGIN(ctx, t0);
+		PROF_ENTER(PROF_LEX, p0);
+		token_t* token = lexer(ctx);
+		PROF_LEAVE(p0);
+		TIME_END(ctx, lex, t0);
 		DEBUG(tokenDebug("lexed", token);)
+		if (token->t == END) {
+			tokenFree(ctx, token);
+			break;
+		}
+		if (numTokens < MAX_ARGS)
+			tokens[numTokens++] = token;
+		else
+			tokenFree(ctx, token);
+#ifdef INCL_EXIT
+		if (token->t == EXIT)
+			break;
+#endif
+	} while (true);
+	lexerClose(ctx);
+	return numTokens;
+}
+
+/**
+ * Evaluate a command that has already been split into tokens
+ * \param src  Array of tokens from tokenize, they are not modified or freed
+ * \param numSrc  Number of tokens
+ * \return token Result of evaluation (STR, NUM, EMPTY), NULL on exit *MUST BE FREED*
+ */
+token_t* evalTokens(mon_ctx_t* ctx, token_t* src[], int numSrc)
+{
+	int numTokens = 0;
+	token_t* tokens[MAX_ARGS];
+	bool owned[MAX_ARGS];
+	token_t* result = NULL;
+	bool exiting = false;
+	token_t* error = NULL;
+	bool errorOwned = false;
+	bool reported = false;
+
+	for (int i=0; i<numSrc; i++) {
+		token_t* token = src[i];
+		bool own = false;
+		bool exe = false;
+		// Do not save EXE token, it applies to the next token
+		while ((token->t == EXE) && (i+1 < numSrc)) {
+			DEBUG(tokenDebug("  exe", token);)
+			token = src[++i];
+			exe = true;
+		}
 #ifdef INCL_EXIT
 		if (token->t == EXIT) {
-			for (int i=0; i<numTokens; i++)
-				tokenFree(tokens[i]);
-			monExit = true;
-			result = NULL;
+			ctx->monExit = true;
+			exiting = true;
 			break;
-		} else
+		}
 #endif
-		if (token->t == END) {
-			tokenFree(token);
-			// process command
-			result = command(&tokens[0], numTokens);
-			// free tokens
-			for (int i=0; i<numTokens; i++) {
-				DEBUG(tokenDebug("free", tokens[i]);)
-				tokenFree(tokens[i]);
-			}
+#ifdef INCL_EXPR
+		if (token->t == EXPR) {
+			token_t* r = tokenAlloc(ctx, "eval expr");
+			exprEval(ctx, token->v.s, r);
+			token = r;
+			own = true;
+			DEBUG(tokenDebug("  expr", token);)
+		}
+#endif
+		// The lexer makes ERR tokens for numbers that don't fit
+		if (token->t == ERR) {
+			error = token;
+			errorOwned = own;
 			break;
+		}
 #ifdef INCL_REG
-		} else if (token->t == GET) {
-			token_t* newToken = getReg(token->v.c);
-			if (newToken != NULL) {
-				tokenFree(token);
-				token = tokenDup(newToken, "eval");
-				DEBUG(tokenDebug("  got", token);)
-			} else
-				token->t = REG;
-#endif
-		} else if (token->t == EXE) {
-			DEBUG(tokenDebug("  exe", token);)
-			exeCount = 2;
-			tokenFree(token);
+		if (token->t == GET) {
+			token = tokenDup(ctx, getReg(ctx, token->v.c), "eval");
+			own = true;
+			DEBUG(tokenDebug("  got", token);)
 		}
-		if (exeCount == 2) {
-			// Do not save EXE token
-			exeCount--;
-		} else if (exeCount == 1) {
-			exeCount--;
-			// If the next token is a string
-			if (token->t == STR) {
-				token_t* old = token;
-				token = eval(token->v.s);
-				if (token->t != EMPTY)
-					tokens[numTokens++] = token;
-				else
-					tokenFree(token);
-				tokenFree(old);
-			} else {
-				if (token->t != EMPTY)
-					tokens[numTokens++] = token;
-				else
-					tokenFree(token);
+#endif
+		// If the token after an EXE is a string evaluate it
+		if (exe && (token->t == STR)) {
+			token_t* old = token;
+			token = eval(ctx, token->v.s);
+			if (own)
+				tokenFree(ctx, old);
+			if (token == NULL) {
+				exiting = true;
+				break;
+			}
+			own = true;
+			// The nested command has reported its error, stop this one
+			if (token->t == ERR) {
+				error = token;
+				errorOwned = reported = true;
+				break;
 			}
-		} else {
-			if (token->t != EMPTY)
-				tokens[numTokens++] = token;
-			else
-				tokenFree(token);
 		}
-	} while (true);
-	lexerClose();
-	DEBUG(tokenDebug("eval end", token);)
+		if ((token->t != EMPTY) && (token->t != EXE) && (numTokens < MAX_ARGS)) {
+			tokens[numTokens] = token;
+			owned[numTokens++] = own;
+		} else if (own)
+			tokenFree(ctx, token);
+	}
+	if (error != NULL) {
+		if (!reported) {
+			emitErrorOpen(ctx);
+			transmitString(ctx, error->v.s);
+			emitErrorClose(ctx);
+		}
+		result = errorOwned ? error : tokenDup(ctx, error, "eval");
+	} else if (!exiting)
+		result = command(ctx, &tokens[0], numTokens);
+	// free tokens
+	for (int i=0; i<numTokens; i++) {
+		if (owned[i]) {
+			DEBUG(tokenDebug("free", tokens[i]);)
+			tokenFree(ctx, tokens[i]);
+		}
+	}
+	DEBUG(if (result) tokenDebug("eval end", result);)
+	return result;
+}
+
+/**
+ * Evaluate Command, at most MAX_NEST deep
+ * \param input  String containing command
+ * \return token Result of evaluation (STR, NUM, EMPTY, ERR), NULL on exit *MUST BE FREED*
+ */
+token_t* eval(mon_ctx_t* ctx, char *input)
+{
+	return evalLexed(ctx, input, NULL, 0);
+}
+
+/**
+ * Evaluate a command whose first tokens were lexed as it was typed
+ * \param input  The rest of the command
+ * \param lexed  Tokens lexed from the start of the command, they are freed
+ * \param numLexed  Number of them, fewer than MAX_ARGS
+ * \return token Result of evaluation (STR, NUM, EMPTY, ERR), NULL on exit *MUST BE FREED*
+ */
+token_t* evalLexed(mon_ctx_t* ctx, char *input, token_t* lexed[], int numLexed)
+{
+	token_t* tokens[MAX_ARGS];
+	int numTokens;
+
+	PROF_ENTER(PROF_DISPATCH, p0);
+	DEBUG(printf("eval \"%s\" begin\n", input);)
+	TRACE(TRACE_EVAL, ctx->evalDepth + 1);
+	if ((++ctx->evalDepth == 1) ||
+		((ctx->evalDepth <= MAX_NEST) && (tokensFree(ctx) >= NEST_TOKENS))) {
+		if (ctx->evalDepth > ctx->evalMax)
+			ctx->evalMax = ctx->evalDepth;
+		for (int i=0; i<numLexed; i++)
+			tokens[i] = lexed[i];
+		numTokens = tokenize(ctx, input, tokens, numLexed);
+	} else {
+		for (int i=0; i<numLexed; i++)
+			tokenFree(ctx, lexed[i]);
+		numTokens = nestError(ctx, tokens);
+	}
+	token_t* result = evalTokens(ctx, tokens, numTokens);
+	ctx->evalDepth--;
+	for (int i=0; i<numTokens; i++)
+		tokenFree(ctx, tokens[i]);
+	TRACE(TRACE_EVAL_END, (result != NULL) ? result->t : 0xFFFF);
+	PROF_LEAVE(p0);
 	return result;
 }
@@ -34,14 +34,12 @@
 #define NUM_REGS		8
 #define MAX_CMD_LEN		41
 
-extern bool monExit;
-extern char prompt[];
+extern int tokenize(mon_ctx_t* ctx, char *input, token_t* tokens[], int numTokens);
+extern token_t* evalTokens(mon_ctx_t* ctx, token_t* src[], int numSrc);
+extern token_t* eval(mon_ctx_t* ctx, char *input);
+extern token_t* evalLexed(mon_ctx_t* ctx, char *input, token_t* lexed[], int numLexed);
 
-extern token_t* eval(char *input);
-
-extern void setReg(char reg, token_t* t);
-extern token_t* getReg(char reg);
-
-extern char* formatNum(int n);
+extern void setReg(mon_ctx_t* ctx, char reg, token_t* t);
+extern token_t* getReg(mon_ctx_t* ctx, char reg);
 
 #endif
@@ -0,0 +1,152 @@
+/**
+ * \file prof.c
+ * \brief Sampling profiler of the monitor's own phases.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "prof.h"
+#include "context.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "pgm.h"
+#include "main.h"
+
+volatile unsigned char profPhase = PROF_OTHER;  //!< Current phase
+const char* volatile profCmd;  //!< Name, in program memory, of the command running in PROF_CMD
+
+static const char* const names[PROF_PHASES] = {
+	"other", "dispatch", "lex", "commands", "tokens", "format", "transmit"
+};
+static volatile bool running = false;
+static volatile unsigned long hits[PROF_PHASES];  //!< Samples of each phase
+static const char* volatile cmdName[PROF_CMDS];  //!< Commands sampled
+static volatile unsigned long cmdHits[PROF_CMDS];  //!< Samples of each command
+
+/**
+ * \brief Count the phase the monitor is in. Called from the profiling
+ * timer's interrupt (SIGPROF on a host) so it only reads the markers and
+ * bumps counters. Commands beyond PROF_CMDS are counted in the phase only.
+ */
+void profSample()
+{
+	if (!running)
+		return;
+	unsigned char p = profPhase;
+	if (p >= PROF_PHASES)
+		return;
+	hits[p]++;
+	if (p != PROF_CMD)
+		return;
+	const char* cmd = profCmd;
+	for (int i=0; i<PROF_CMDS; i++) {
+		if (cmdName[i] == NULL)
+			cmdName[i] = cmd;
+		if (cmdName[i] == cmd) {
+			cmdHits[i]++;
+			break;
+		}
+	}
+}
+
+/**
+ * \brief Print one histogram line, the count, its share and a bar
+ * \param label  What was sampled
+ * \param n  Samples of it
+ * \param total  All samples
+ */
+static void bar(mon_ctx_t* ctx, const char* label, unsigned long n, unsigned long total)
+{
+	unsigned pc = (n * 100 + total / 2) / total;
+	unsigned len = strlen(label);
+	if (len < 10)
+		emitPad(ctx, 10 - len);
+	emitStr(ctx, label, len);
+	emitUnsigned(ctx, n, 8);
+	emitUnsigned(ctx, pc, 4);
+	emitString(ctx, "% ");
+	for (unsigned i=0; i<pc; i+=4)
+		emitString(ctx, "#");
+	emitString(ctx, EOL);
+}
+
+/**
+ * \brief Print the histogram of the phases, then of the commands
+ */
+static void report(mon_ctx_t* ctx)
+{
+	unsigned long total = 0;
+	for (int i=0; i<PROF_PHASES; i++)
+		total += hits[i];
+	emitString(ctx, "samples ");
+	emitUnsigned(ctx, total, 0);
+	transmitString(ctx, running ? ", running" EOL : EOL);
+	if (total == 0)
+		return;
+	for (int i=0; i<PROF_PHASES; i++)
+		bar(ctx, names[i], hits[i], total);
+	for (int i=0; (i<PROF_CMDS) && (cmdName[i] != NULL); i++) {
+		char name[MAX_STRING];
+		bar(ctx, pgmStrcpy(name, cmdName[i], sizeof(name)), cmdHits[i], total);
+	}
+}
+
+/**
+ * \brief Sample what the monitor is doing every PROF_PERIOD_US of CPU
+ * time, for hot paths on a target that can't run a profiler.
+ * \param args  'start' clears the counts and starts sampling, 'stop'
+ * stops it and 'report' prints the histogram
+ * \param nArgs  1
+ * \returns 'EMPTY' or 'ERR' token (must be freed)
+ */
+token_t* cmd_prof(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	token_t* r = tokenAlloc(ctx, "cmd_prof");
+	char buf[FORMAT_LEN];
+	char* s = tokenGetText(ctx, args[0], buf);
+	r->t = EMPTY;
+
+	if (!strcmp(s, "start")) {
+		running = false;
+		for (int i=0; i<PROF_PHASES; i++)
+			hits[i] = 0;
+		for (int i=0; i<PROF_CMDS; i++) {
+			cmdName[i] = NULL;
+			cmdHits[i] = 0;
+		}
+		running = profTimer(PROF_PERIOD_US);
+		if (!running)
+			emitError(ctx, r, MSG_NO_TIMER);
+	} else if (!strcmp(s, "stop")) {
+		running = false;
+		profTimer(0);
+	} else if (!strcmp(s, "report")) {
+		report(ctx);
+	} else
+		emitError(ctx, r, MSG_ARGUMENT);
+	return r;
+}
@@ -0,0 +1,71 @@
+/**
+ * \file prof.h
+ * \brief Sampling profiler of the monitor's own phases.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_PROF_H)
+#define _PROF_H
+
+#include <stdbool.h>
+
+#include "token.h"
+
+#define PROF_PERIOD_US	1000	//!< Sample period
+#define PROF_CMDS		8		//!< Commands counted separately
+
+/**
+ * \brief What the monitor is doing, set where each phase starts
+ */
+enum {
+	PROF_OTHER,  //!< Line editing, the event loop, anything unmarked
+	PROF_DISPATCH,  //!< eval(), command lookup and argument checks
+	PROF_LEX,  //!< lexer()
+	PROF_CMD,  //!< A cmd_* function, profCmd says which
+	PROF_TOKEN,  //!< tokenAlloc()
+	PROF_FORMAT,  //!< Number formatting
+	PROF_TX,  //!< transmit()
+	PROF_PHASES
+};
+
+extern volatile unsigned char profPhase;
+extern const char* volatile profCmd;  //!< Command name in program memory (pgm.h)
+
+#ifdef INCL_PROF
+#define PROF_ENTER(p, v)		unsigned char v = profPhase; profPhase = (p)
+#define PROF_LEAVE(v)			profPhase = (v)
+#define PROF_COMMAND(name, v)	const char* v = profCmd; profCmd = (name)
+#define PROF_COMMAND_END(v)		profCmd = (v)
+#else
+#define PROF_ENTER(p, v)
+#define PROF_LEAVE(v)
+#define PROF_COMMAND(name, v)
+#define PROF_COMMAND_END(v)
+#endif
+
+extern void profSample();
+
+extern token_t* cmd_prof(mon_ctx_t* ctx, token_t *args[], int nArgs);
+
+#endif
@@ -0,0 +1,475 @@
+/**
+ * \file replay.c
+ * \brief Replay recorded sessions through the monitor and report latency.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "monitor.h"
+#include "host.h"
+#include "timecmd.h"
+#include "prof.h"
+#include "pgm.h"
+#include "main.h"
+
+#define LE	'\n'	//!< Line end, as in monitor.c for BIG builds
+
+/**
+ * \brief Growable byte buffer, used for files and captured output
+ */
+typedef struct {
+	char* data;  //!< Contents
+	size_t len;  //!< Bytes used
+	size_t size;  //!< Bytes allocated
+} buf_t;
+
+/**
+ * \brief Append to a buffer.
+ * \param b  The buffer
+ * \param p  Bytes to add
+ * \param n  Number of bytes
+ */
+static void bufAdd(buf_t* b, const char* p, size_t n)
+{
+	if (b->len + n > b->size) {
+		b->size = (b->len + n) * 2;
+		b->data = realloc(b->data, b->size);
+		if (b->data == NULL) {
+			perror("replay");
+			exit(2);
+		}
+	}
+	memcpy(b->data + b->len, p, n);
+	b->len += n;
+}
+
+/**
+ * \brief Read a whole file.
+ * \param path  File name
+ * \param b  Buffer to fill
+ * \returns false if the file can't be read
+ */
+static bool bufRead(const char* path, buf_t* b)
+{
+	char chunk[4096];
+	size_t n;
+	FILE* f = fopen(path, "rb");
+	if (f == NULL)
+		return false;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		bufAdd(b, chunk, n);
+	fclose(f);
+	return true;
+}
+
+/**
+ * \brief Capture output, the context's port is the capture buffer.
+ * \param ctx  Monitor context of the session.
+ * \param pData  A pointer to the string.
+ * \param size  The length of the string.
+ */
+void transmit(mon_ctx_t* ctx, char *pData, unsigned size)
+{
+	PROF_ENTER(PROF_TX, p0);
+	TIME_COUNT(ctx, tx, size);
+	bufAdd(ctx->port, pData, size);
+	PROF_LEAVE(p0);
+}
+
+/**
+ * \brief Read a nanosecond clock, finer than clockMicros() as most lines
+ * take well under a microsecond.
+ * \returns Nanoseconds.
+ */
+static unsigned long long nanos()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmpLat(const void* a, const void* b)
+{
+	unsigned long x = *(const unsigned long*)a, y = *(const unsigned long*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * \brief Feed a session to a fresh monitor as main.c would, timing each
+ * line from its LE until the next prompt has been sent.
+ * \param in  The session's input
+ * \param out  Captured output, emptied first
+ * \param lat  Latencies in ns, one is appended per line
+ * \param nLat  Number of latencies in lat
+ * \returns Total ns spent in the monitor
+ */
+static unsigned long long replay(buf_t* in, buf_t* out, unsigned long* lat, size_t* nLat)
+{
+	static mon_ctx_t ctx;
+	unsigned long long total = 0;
+
+	out->len = 0;
+	monInit(&ctx);
+	ctx.port = out;
+	transmit(&ctx, ctx.prompt, strlen(ctx.prompt));
+	transmit(&ctx, " ", 1);
+	for (size_t i=0; (i<in->len) && !ctx.monExit; i++) {
+		unsigned long long t0 = nanos();
+		processChar(&ctx, in->data[i]);
+		unsigned long long t = nanos() - t0;
+		total += t;
+		if (in->data[i] == LE)
+			lat[(*nLat)++] = t;
+	}
+	transmit(&ctx, EOL, 1);
+	return total;
+}
+
+/**
+ * \brief Find where the output first differs from what was expected.
+ * \param out  Captured output
+ * \param exp  Expected output
+ * \returns Line number of the first difference, 0 if they are the same
+ */
+static unsigned differs(buf_t* out, buf_t* exp)
+{
+	size_t i;
+	unsigned line = 1;
+	for (i=0; (i<out->len) && (i<exp->len) && (out->data[i] == exp->data[i]); i++)
+		if (out->data[i] == '\n')
+			line++;
+	return ((i == out->len) && (i == exp->len)) ? 0 : line;
+}
+
+/**
+ * \brief Report where the output first differs from what was expected.
+ * \param name  Session name
+ * \param out  Captured output
+ * \param exp  Expected output
+ * \returns true if they are the same
+ */
+static bool check(const char* name, buf_t* out, buf_t* exp)
+{
+	unsigned line = differs(out, exp);
+	if (line == 0)
+		return true;
+	printf("%s: output differs from expected at line %u" EOL, name, line);
+	return false;
+}
+
+/**
+ * \brief Result of one batch session, written by the process that ran it
+ */
+typedef struct {
+	int status;  //!< BATCH_OK etc.
+	unsigned diffLine;  //!< First line that differs, for BATCH_DIFFERS
+	size_t lines;  //!< Lines replayed
+	unsigned long long ns;  //!< Time spent in the monitor
+	unsigned long long wall;  //!< Time from fork to exit
+} result_t;
+
+enum { BATCH_CRASHED, BATCH_OK, BATCH_DIFFERS, BATCH_NO_FILE, BATCH_NO_FORK };
+
+/**
+ * \brief Batch state shared by the workers
+ */
+typedef struct {
+	unsigned long next;  //!< Next session to claim
+	result_t r[];  //!< One per session
+} batch_t;
+
+/**
+ * \brief Replace the digits before " bytes/s" by N, as make test's sed
+ * does, since throughput varies from run to run.
+ * \param b  Captured output
+ */
+static void normalise(buf_t* b)
+{
+	static const char unit[] = " bytes/s";
+	size_t j = 0;
+	for (size_t i=0; i<b->len; ) {
+		size_t k = i;
+		while ((k < b->len) && (b->data[k] >= '0') && (b->data[k] <= '9'))
+			k++;
+		if ((k > i) && (b->len - k >= sizeof(unit) - 1)
+				&& (memcmp(b->data + k, unit, sizeof(unit) - 1) == 0)) {
+			b->data[j++] = 'N';
+			i = k;
+		} else if (k > i) {
+			memmove(b->data + j, b->data + i, k - i);
+			j += k - i;
+			i = k;
+		} else
+			b->data[j++] = b->data[i++];
+	}
+	b->len = j;
+}
+
+/**
+ * \brief Replay one session of a batch against its expect file,
+ * expectN_<bits> if there is one, else expectN.
+ * \param name  Session file, .../testN
+ * \param r  Where to put the result
+ */
+static void runSession(const char* name, result_t* r)
+{
+	buf_t in = { 0 }, out = { 0 }, exp = { 0 };
+	char expName[FILENAME_MAX];
+	const char* base = strrchr(name, '/');
+	base = (base == NULL) ? name : base + 1;
+	if ((strncmp(base, "test", 4) != 0) || (strlen(name) + 8 >= sizeof(expName))) {
+		r->status = BATCH_NO_FILE;
+		return;
+	}
+	int dir = base - name;
+	snprintf(expName, sizeof(expName), "%.*sexpect%s_%d", dir, name, base + 4, NUM_BITS);
+	if (access(expName, R_OK) != 0)
+		snprintf(expName, sizeof(expName), "%.*sexpect%s", dir, name, base + 4);
+	if (!bufRead(name, &in) || !bufRead(expName, &exp)) {
+		r->status = BATCH_NO_FILE;
+		return;
+	}
+
+	size_t lines = 1;
+	for (size_t i=0; i<in.len; i++)
+		if (in.data[i] == LE)
+			lines++;
+	unsigned long* lat = malloc(lines * sizeof(unsigned long));
+	r->ns = replay(&in, &out, lat, &r->lines);
+	normalise(&out);
+	r->diffLine = differs(&out, &exp);
+	r->status = (r->diffLine == 0) ? BATCH_OK : BATCH_DIFFERS;
+}
+
+/**
+ * \brief Claim sessions until there are none left, running each in a
+ * forked child so it starts from a fresh monitor, simulated memory and
+ * module state whatever ran before it.
+ * \param b  Shared batch state
+ * \param names  Session files
+ * \param n  Number of sessions
+ */
+static void worker(batch_t* b, char* names[], unsigned long n)
+{
+	unsigned long i;
+	while ((i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED)) < n) {
+		result_t* r = &b->r[i];
+		unsigned long long t0 = nanos();
+		int status;
+		r->status = BATCH_CRASHED;
+		pid_t pid = fork();
+		if (pid == 0) {
+			runSession(names[i], r);
+			_exit(0);
+		}
+		if ((pid < 0) || (waitpid(pid, &status, 0) < 0))
+			r->status = BATCH_NO_FORK;
+		r->wall = nanos() - t0;
+	}
+}
+
+/**
+ * \brief Replay many sessions on a pool of worker processes and report
+ * each one's result and timing, then a summary.
+ * \param names  Session files
+ * \param n  Number of sessions
+ * \param jobs  Number of workers
+ * \returns 0 if every output is as expected, 1 if not, 2 on error
+ */
+static int batch(char* names[], unsigned long n, long jobs)
+{
+	batch_t* b = mmap(NULL, sizeof(batch_t) + n * sizeof(result_t),
+					  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (b == MAP_FAILED) {
+		perror("aMonReplay");
+		return 2;
+	}
+	if (jobs > (long)n)
+		jobs = n;
+	fflush(stdout);
+	unsigned long long t0 = nanos();
+	for (long j=0; j<jobs; j++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			worker(b, names, n);
+			_exit(0);
+		}
+		if (pid < 0) {
+			perror("aMonReplay");
+			jobs = j;
+			break;
+		}
+	}
+	// Sessions are claimed, not dealt, so fewer workers just take longer
+	if (jobs == 0)
+		worker(b, names, n);
+	while (wait(NULL) > 0)
+		;
+	unsigned long long wall = nanos() - t0;
+
+	static const char* const fails[] = {
+		[BATCH_CRASHED] = "crashed", [BATCH_NO_FILE] = "can't read session or expect file",
+		[BATCH_NO_FORK] = "can't fork",
+	};
+	unsigned long failed = 0;
+	unsigned long long ns = 0;
+	for (unsigned long i=0; i<n; i++) {
+		result_t* r = &b->r[i];
+		if (r->status == BATCH_OK)
+			printf("%s: ok, %zu lines, %.3f ms in monitor, %.3f ms wall" EOL,
+				   names[i], r->lines, r->ns / 1e6, r->wall / 1e6);
+		else if (r->status == BATCH_DIFFERS)
+			printf("%s: output differs from expected at line %u" EOL, names[i], r->diffLine);
+		else
+			printf("%s: %s" EOL, names[i], fails[r->status]);
+		failed += (r->status != BATCH_OK);
+		ns += r->ns;
+	}
+	printf("%lu sessions, %lu failed, %ld jobs, %.1f ms wall, %.1f ms in monitor, %.0f sessions/s" EOL,
+		   n, failed, jobs ? jobs : 1, wall / 1e6, ns / 1e6, n * 1e9 / (wall ? wall : 1));
+	munmap(b, sizeof(batch_t) + n * sizeof(result_t));
+	return failed ? 1 : 0;
+}
+
+/**
+ * \brief Write a script of 'lines' commands that exercises registers,
+ * math, nesting, history and line editing. The same script every time.
+ * \param lines  Number of lines
+ */
+static void generate(unsigned long lines)
+{
+	static const char* const cmds[] = {
+		"set %c %lu", "get %c", "add %lu 7", "sub %lu 0x1F", "mul %lu 3",
+		"echo !\"add %lu 1\"", "set %c !\"mul $a 2\"", "echo $%c", "hex",
+		"\x15\x15", "add 1%lu\x02\x02\x1b[3~2", "\x12" "add\x05 9",
+	};
+	unsigned long seed = 12345;
+	printf("set a 1" EOL);
+	for (unsigned long i=1; i<lines; i++) {
+		seed = seed * 1103515245 + 12345;
+		const char* fmt = cmds[(seed >> 16) % (sizeof(cmds) / sizeof(cmds[0]))];
+		char reg = 'a' + (seed >> 8) % NUM_REGS;
+		unsigned long n = (seed >> 4) % 1000;
+		if (strstr(fmt, "%c") && strstr(fmt, "%lu"))
+			printf(fmt, reg, n);
+		else if (strstr(fmt, "%c"))
+			printf(fmt, reg);
+		else
+			printf(fmt, n);
+		printf(EOL);
+	}
+	printf("exit" EOL);
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: aMonReplay [-r runs] session [expected]\n"
+			"       aMonReplay -b [-j jobs] session...\n"
+			"       aMonReplay -g lines > script\n");
+	exit(2);
+}
+
+/**
+ * \brief Replay a recorded session, check its output and report the
+ * latency distribution of its lines, or with -b replay a batch of sessions
+ * in parallel.
+ * \param argc  Argument count
+ * \param argv  Options, session file and optional expected output file, or
+ * with -b the session files
+ * \returns 0 if the output is as expected, 1 if not, 2 on error
+ */
+int main(int argc, char* argv[])
+{
+	int runs = 1;
+	int opt;
+	bool many = false;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	buf_t in = { 0 }, out = { 0 }, exp = { 0 };
+
+	while ((opt = getopt(argc, argv, "r:g:bj:")) != -1) {
+		if (opt == 'r')
+			runs = atoi(optarg);
+		else if (opt == 'b')
+			many = true;
+		else if (opt == 'j')
+			jobs = atol(optarg);
+		else if (opt == 'g') {
+			generate(strtoul(optarg, NULL, 0));
+			return 0;
+		} else
+			usage();
+	}
+	if (many) {
+		if ((optind >= argc) || (jobs < 1))
+			usage();
+		hostMemInit();
+		return batch(argv + optind, argc - optind, jobs);
+	}
+	if ((optind >= argc) || (optind + 2 < argc) || (runs < 1))
+		usage();
+	const char* name = argv[optind];
+	const char* expName = (optind + 1 < argc) ? argv[optind + 1] : NULL;
+	if (!bufRead(name, &in) || ((expName != NULL) && !bufRead(expName, &exp))) {
+		perror("aMonReplay");
+		return 2;
+	}
+	hostMemInit();
+
+	size_t perRun = 1;
+	for (size_t i=0; i<in.len; i++)
+		if (in.data[i] == LE)
+			perRun++;
+	unsigned long* lat = malloc(perRun * runs * sizeof(unsigned long));
+	size_t nLat = 0;
+	unsigned long long total = 0;
+	bool ok = true;
+	for (int r=0; r<runs; r++) {
+		total += replay(&in, &out, lat, &nLat);
+		if ((expName != NULL) && ok)
+			ok = check(name, &out, &exp);
+	}
+	if (nLat == 0) {
+		printf("%s: no lines" EOL, name);
+		return ok ? 0 : 1;
+	}
+
+	qsort(lat, nLat, sizeof(unsigned long), cmpLat);
+	printf("%s: %zu lines%s, ns p50 %lu p99 %lu max %lu, %.0f lines/s" EOL,
+		   name, nLat, (expName == NULL) ? "" : (ok ? ", output ok" : ", OUTPUT WRONG"),
+		   lat[(nLat - 1) / 2], lat[(nLat * 99 + 99) / 100 - 1], lat[nLat - 1],
+		   nLat * 1e9 / (total ? total : 1));
+#ifdef PGM_COUNT
+	printf("%s: %.1f flash reads per line" EOL, name, (double)pgmReads / nLat);
+#endif
+	free(lat);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+/**
+ * \file server.c
+ * \brief Serve independent monitor sessions over a Unix socket.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "monitor.h"
+#include "host.h"
+#include "watch.h"
+#include "timecmd.h"
+#include "prof.h"
+#include "main.h"
+
+#define SERVER_PATH		"/tmp/aMon.sock"	//!< Default socket path
+#define MAX_SESSIONS	16		//!< Most clients served at once
+#define SESSION_OUT		4096	//!< Output buffered for a client before it is dropped
+#define MAX_EVENTS		16		//!< Events handled per epoll_wait
+
+/**
+ * \brief A client connection, its monitor context's port points back here
+ */
+typedef struct {
+	int fd;  //!< Client socket
+	unsigned outLen;  //!< Bytes waiting in out
+	bool overflow;  //!< Client is not reading its output, drop it
+	bool writable;  //!< Waiting for EPOLLOUT
+	char out[SESSION_OUT];  //!< Output not yet accepted by the socket
+	mon_ctx_t ctx;  //!< The session's monitor
+} session_t;
+
+static session_t* sessions[MAX_SESSIONS];
+static int ep;
+static int listenFd;
+
+/**
+ * \brief Queue output for a session's client.
+ * \param ctx  Monitor context of the session.
+ * \param pData  A pointer to the string.
+ * \param size  The length of the string.
+ */
+void transmit(mon_ctx_t* ctx, char *pData, unsigned size)
+{
+	session_t* ss = ctx->port;
+
+	PROF_ENTER(PROF_TX, p0);
+	TIME_COUNT(ctx, tx, size);
+	if (ss->overflow)
+		;
+	else if (size > SESSION_OUT - ss->outLen)
+		ss->overflow = true;
+	else {
+		memcpy(&ss->out[ss->outLen], pData, size);
+		ss->outLen += size;
+	}
+	PROF_LEAVE(p0);
+}
+
+/**
+ * \brief Send as much queued output as the socket accepts, and wait for
+ * EPOLLOUT if some is left.
+ * \param ss  The session
+ * \returns false if the connection has failed
+ */
+static bool flush(session_t* ss)
+{
+	unsigned done = 0;
+	while (done < ss->outLen) {
+		ssize_t n = send(ss->fd, &ss->out[done], ss->outLen - done, MSG_NOSIGNAL);
+		if (n < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				break;
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		done += n;
+	}
+	memmove(ss->out, &ss->out[done], ss->outLen - done);
+	ss->outLen -= done;
+	bool writable = (ss->outLen > 0);
+	if (writable != ss->writable) {
+		struct epoll_event ev = { EPOLLIN | (writable ? EPOLLOUT : 0), { .ptr = ss } };
+		epoll_ctl(ep, EPOLL_CTL_MOD, ss->fd, &ev);
+		ss->writable = writable;
+	}
+	return true;
+}
+
+/**
+ * \brief End a session, its watches stop with it.
+ * \param i  Index in sessions
+ */
+static void sessionClose(int i)
+{
+	session_t* ss = sessions[i];
+	watchStop(&ss->ctx);
+	epoll_ctl(ep, EPOLL_CTL_DEL, ss->fd, NULL);
+	close(ss->fd);
+	free(ss);
+	sessions[i] = NULL;
+}
+
+/**
+ * \brief Accept a client and start a session with a fresh context.
+ */
+static void sessionOpen()
+{
+	int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+	int i;
+	for (i=0; (i<MAX_SESSIONS) && (sessions[i] != NULL); i++)
+		;
+	session_t* ss = (i < MAX_SESSIONS) ? calloc(1, sizeof(session_t)) : NULL;
+	if (ss == NULL) {
+		close(fd);
+		return;
+	}
+	ss->fd = fd;
+	monInit(&ss->ctx);
+	ss->ctx.port = ss;
+	sessions[i] = ss;
+	struct epoll_event ev = { EPOLLIN, { .ptr = ss } };
+	epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+	transmit(&ss->ctx, ss->ctx.prompt, strlen(ss->ctx.prompt));
+	transmit(&ss->ctx, " ", 1);
+}
+
+/**
+ * \brief Pass a client's input to its monitor.
+ * \param ss  The session
+ * \returns false if the client has gone
+ */
+static bool sessionInput(session_t* ss)
+{
+	char buf[256];
+	ssize_t n = recv(ss->fd, buf, sizeof(buf), 0);
+	if (n < 0)
+		return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+	if (n == 0)
+		return false;
+	for (int i=0; (i<n) && !ss->ctx.monExit; i++)
+		processChar(&ss->ctx, buf[i]);
+	return true;
+}
+
+/**
+ * \brief Create the listening socket.
+ * \param path  Socket path, replaced if it exists
+ * \returns The file descriptor, or -1 on failure.
+ */
+static int serverListen(const char* path)
+{
+	struct sockaddr_un addr;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if ((bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) || (listen(fd, MAX_SESSIONS) < 0)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * \brief Serve monitor sessions, one per client, from a single epoll loop.
+ * Sessions share the timers and simulated memory but nothing else.
+ * \param argc  Argument count
+ * \param argv  Optional socket path
+ */
+int main(int argc, char* argv[])
+{
+	const char* path = (argc > 1) ? argv[1] : SERVER_PATH;
+	struct epoll_event events[MAX_EVENTS];
+
+	hostStackPaint();
+	hostMemInit();
+	listenFd = serverListen(path);
+	if (listenFd < 0) {
+		perror(path);
+		return 1;
+	}
+	hostTickStart();
+	ep = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev = { EPOLLIN, { .ptr = &listenFd } };
+	epoll_ctl(ep, EPOLL_CTL_ADD, listenFd, &ev);
+	fprintf(stderr, "aMonServer listening on %s\n", path);
+
+	while (true) {
+		// Sleep until a client needs service or a watch is due
+		int n = epoll_wait(ep, events, MAX_EVENTS, hostTickWait());
+		hostTick();
+		for (int i=0; i<n; i++) {
+			void* p = events[i].data.ptr;
+			if (p == &listenFd) {
+				sessionOpen();
+			} else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+				session_t* ss = p;
+				if (!sessionInput(ss))
+					ss->ctx.monExit = true;
+			}
+		}
+		// Send output, including any from watches, and end finished sessions
+		for (int i=0; i<MAX_SESSIONS; i++) {
+			session_t* ss = sessions[i];
+			if (ss == NULL)
+				continue;
+			if (!flush(ss) || ss->overflow || (ss->ctx.monExit && (ss->outLen == 0)))
+				sessionClose(i);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * \file stack.c
+ * \brief Stack painting and high water mark.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "stack.h"
+#include "context.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+static volatile unsigned char* low = NULL;  //!< Deepest byte of the stack
+static volatile unsigned char* high = NULL;  //!< Byte after the top of the stack
+
+/**
+ * \brief Paint the stack so stackUsed() can find how deep it has been.
+ * The stack is assumed to grow down, from top towards bottom.
+ * \note Call once at startup, e.g. with the linker's end of stack symbol
+ * and a little below the current stack pointer. Nothing in the range may
+ * be in use.
+ * \param bottom  Lowest address of the stack
+ * \param top  Address after the highest byte to paint
+ */
+void stackPaint(void* bottom, void* top)
+{
+	low = bottom;
+	high = top;
+	for (volatile unsigned char* p = low; p < high; p++)
+		*p = STACK_FILL;
+}
+
+/**
+ * \brief Stack high water mark, the paint that has been overwritten. A
+ * byte written with STACK_FILL is not seen so it may read a little low.
+ * \returns Bytes of the painted stack that have been used
+ */
+unsigned long stackUsed()
+{
+	volatile unsigned char* p = low;
+	while ((p < high) && (*p == STACK_FILL))
+		p++;
+	return high - p;
+}
+
+/**
+ * \brief Report the stack high water mark and the deepest nesting of
+ * commands (!"...") seen in this session.
+ * \param ctx  Monitor context
+ * \param args  None
+ * \param nArgs  0
+ * \returns 'EMPTY', or 'ERR' if the stack was not painted (must be freed)
+ */
+token_t* cmd_stack(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	token_t* r = tokenAlloc(ctx, "cmd_stack");
+
+	if (high == NULL) {
+		emitError(ctx, r, MSG_NO_PAINT);
+		return r;
+	}
+	emitString(ctx, "stack: ");
+	emitUnsigned(ctx, stackUsed(), 0);
+	emitString(ctx, " of ");
+	emitUnsigned(ctx, high - low, 0);
+	emitString(ctx, " bytes, nesting ");
+	emitUnsigned(ctx, ctx->evalMax, 0);
+	emitString(ctx, " of ");
+	emitUnsigned(ctx, MAX_NEST, 0);
+	emitString(ctx, EOL);
+	r->t = EMPTY;
+	return r;
+}
@@ -0,0 +1,376 @@
+/**
+ * \file store.c
+ * \brief Registers and settings kept in flash, a log of CRC'd records.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "store.h"
+#include "context.h"
+#include "process.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+/*
+ * Each page starts with a header record holding its sequence number, the
+ * valid page with the highest is the active one. Records are appended
+ * after it: key, length, data, CRC-16 of the three, padded to STORE_ALIGN.
+ * Erased flash (0xFF) ends the log. A later record for a key replaces an
+ * earlier one. When the active page is full, or its log was cut short by
+ * a reset, the next page in turn is erased, every value written to it and
+ * then its header, so a reset part way leaves the old page active.
+ */
+
+#define KEY_PAGE	0x00	//!< Page header, the data is the sequence number
+#define KEY_FREE	0xFF	//!< Erased flash, the end of the log
+#define KEY_PROMPT	'P'		//!< Prompt
+#define KEY_DECIMAL	'D'		//!< outputDecimal
+#define KEY_ANSI	'A'		//!< termAnsi
+#define ALIGNED(n)	(((n) + STORE_ALIGN - 1) & ~(STORE_ALIGN - 1))
+#define RECORD(len)	ALIGNED(2 + (len) + 2)	//!< Bytes a record takes
+#define HEADER		RECORD(4)
+#define SETTINGS	3		//!< Items before the registers
+
+#ifdef INCL_REG
+#define ITEMS		(SETTINGS + NUM_REGS)
+#else
+#define ITEMS		SETTINGS
+#endif
+
+static int active = -1;  //!< Page being appended to, -1 if none is valid
+static unsigned end;  //!< Offset of the active page's first free byte
+static uint32_t seq;  //!< Sequence number of the active page
+static bool scanned = false;  //!< active, end and saved are known
+static bool have[ITEMS];  //!< The item has a record in the active page
+static uint16_t saved[ITEMS];  //!< CRC of the item's latest record
+static unsigned at[ITEMS];  //!< Offset of the item's latest record
+
+/**
+ * \brief CRC-16/CCITT-FALSE, bit at a time as records are few and short.
+ * \param crc  CRC so far, 0xFFFF to start
+ * \param p  Bytes
+ * \param n  Number of bytes
+ * \returns The CRC
+ */
+static uint16_t crc16(uint16_t crc, const unsigned char* p, unsigned n)
+{
+	while (n--) {
+		crc ^= *p++ << 8;
+		for (int i=0; i<8; i++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+/**
+ * \brief Key of an item
+ * \param i  Item number
+ * \returns The key
+ */
+static char itemKey(int i)
+{
+	static const char keys[SETTINGS] = { KEY_PROMPT, KEY_DECIMAL, KEY_ANSI };
+	return (i < SETTINGS) ? keys[i] : 'a' + i - SETTINGS;
+}
+
+/**
+ * \brief Item number of a key
+ * \param key  The key
+ * \returns The item, or -1 for an unknown key
+ */
+static int itemOf(unsigned char key)
+{
+	for (int i=0; i<ITEMS; i++)
+		if (itemKey(i) == key)
+			return i;
+	return -1;
+}
+
+/**
+ * \brief Build an item's record, ready to write.
+ * \param ctx  Monitor context to save
+ * \param i  Item number
+ * \param r  Buffer for the record, RECORD(MAX_STRING + 1) bytes
+ * \returns Length of the record, or 0 if the item has no value
+ */
+static unsigned record(mon_ctx_t* ctx, int i, unsigned char* r)
+{
+	unsigned char* d = &r[2];
+	unsigned len;
+
+	if (i == 0) {
+		len = strlen(ctx->prompt);
+		memcpy(d, ctx->prompt, len);
+	} else if (i < SETTINGS) {
+		d[0] = (i == 1) ? ctx->outputDecimal : ctx->termAnsi;
+		len = 1;
+	} else {
+#ifdef INCL_REG
+		// registers keep the token type then the value
+		token_t* t = ctx->regs[i - SETTINGS];
+		if ((t == NULL) || ((t->t != NUM) && (t->t != STR) && (t->t != REG)))
+			return 0;
+		d[0] = t->t;
+		if (t->t == NUM) {
+			len = sizeof(num_t);
+			memcpy(&d[1], &t->v.d, len);
+		} else if (t->t == STR) {
+			len = strlen(t->v.s);
+			memcpy(&d[1], t->v.s, len);
+		} else {
+			len = 1;
+			d[1] = t->v.c;
+		}
+		len++;
+#else
+		return 0;
+#endif
+	}
+	r[0] = itemKey(i);
+	r[1] = len;
+	uint16_t crc = crc16(0xFFFF, r, 2 + len);
+	d[len] = crc;
+	d[len + 1] = crc >> 8;
+	memset(&d[len + 2], KEY_FREE, RECORD(len) - (2 + len + 2));
+	return RECORD(len);
+}
+
+/**
+ * \brief Apply a record's value to the context.
+ * \param ctx  Monitor context
+ * \param i  Item number
+ * \param d  Data
+ * \param len  Length of the data
+ */
+static void apply(mon_ctx_t* ctx, int i, const unsigned char* d, unsigned len)
+{
+	if (i == 0) {
+		if (len < PROMPT_LEN) {
+			memcpy(ctx->prompt, d, len);
+			ctx->prompt[len] = 0;
+		}
+	} else if (i < SETTINGS) {
+		if (len == 1) {
+			if (i == 1)
+				ctx->outputDecimal = d[0];
+			else
+				ctx->termAnsi = d[0];
+		}
+	} else {
+#ifdef INCL_REG
+		token_t t;
+		t.t = (len > 0) ? d[0] : EMPTY;
+		if ((t.t == NUM) && (len == 1 + sizeof(num_t)))
+			memcpy(&t.v.d, &d[1], sizeof(num_t));
+		else if ((t.t == STR) && (len <= MAX_STRING)) {
+			memcpy(t.v.s, &d[1], len - 1);
+			t.v.s[len - 1] = 0;
+		} else if ((t.t == REG) && (len == 2))
+			t.v.c = d[1];
+		else
+			return;  // e.g. saved by a build with another NUM_BITS
+		setReg(ctx, itemKey(i), &t);
+#endif
+	}
+}
+
+/**
+ * \brief Find the active page and the end of its log in one pass,
+ * applying each record to ctx on the way.
+ * \param ctx  Monitor context to restore, or NULL to only find the end
+ */
+static void scan(mon_ctx_t* ctx)
+{
+	active = -1;
+	for (int p=0; p<STORE_PAGES; p++) {
+		const unsigned char* h = flashPage(p);
+		uint16_t crc = crc16(0xFFFF, h, 6);
+		if ((h[0] != KEY_PAGE) || (h[1] != 4) || (h[6] != (crc & 0xFF)) || (h[7] != (crc >> 8)))
+			continue;
+		uint32_t s = h[2] | (h[3] << 8) | ((uint32_t)h[4] << 16) | ((uint32_t)h[5] << 24);
+		if ((active < 0) || ((int32_t)(s - seq) > 0)) {
+			active = p;
+			seq = s;
+		}
+	}
+	scanned = true;
+	memset(have, 0, sizeof(have));
+	if (active < 0)
+		return;
+
+	const unsigned char* pg = flashPage(active);
+	unsigned off = HEADER;
+	while ((off + RECORD(0) <= STORE_PAGE_SIZE) && (pg[off] != KEY_FREE)) {
+		unsigned len = pg[off + 1];
+		uint16_t crc = crc16(0xFFFF, &pg[off], 2 + len);
+		if ((off + RECORD(len) > STORE_PAGE_SIZE) ||
+			(pg[off + 2 + len] != (crc & 0xFF)) || (pg[off + 3 + len] != (crc >> 8))) {
+			off = STORE_PAGE_SIZE;	// cut short, the next save compacts
+			break;
+		}
+		int i = itemOf(pg[off]);
+		if (i >= 0) {
+			have[i] = true;
+			saved[i] = crc;
+			at[i] = off;
+			if (ctx != NULL)
+				apply(ctx, i, &pg[off + 2], len);
+		}
+		off += RECORD(len);
+	}
+	end = off;
+}
+
+/**
+ * \brief Write every item to the next page, then its header.
+ * \param ctx  Monitor context to save
+ * \returns false on a flash error
+ */
+static bool compact(mon_ctx_t* ctx)
+{
+	unsigned char r[RECORD(MAX_STRING + 1)];
+	int p = (active + 1) % STORE_PAGES;
+	unsigned off = HEADER;
+
+	if (!flashErase(p))
+		return false;
+	memset(have, 0, sizeof(have));
+	for (int i=0; i<ITEMS; i++) {
+		unsigned n = record(ctx, i, r);
+		if (n == 0)
+			continue;
+		if (!flashWrite(p, off, r, n))
+			return false;
+		have[i] = true;
+		saved[i] = r[2 + r[1]] | (r[3 + r[1]] << 8);
+		at[i] = off;
+		off += n;
+	}
+	seq++;
+	r[0] = KEY_PAGE;
+	r[1] = 4;
+	r[2] = seq;
+	r[3] = seq >> 8;
+	r[4] = seq >> 16;
+	r[5] = seq >> 24;
+	uint16_t crc = crc16(0xFFFF, r, 6);
+	r[6] = crc;
+	r[7] = crc >> 8;
+	memset(&r[8], KEY_FREE, HEADER - 8);
+	if (!flashWrite(p, 0, r, HEADER))
+		return false;
+	active = p;
+	end = off;
+	return true;
+}
+
+/**
+ * \brief Restore the registers and settings, e.g. at startup. One pass
+ * over the active page, no RAM beyond the values themselves.
+ * \param ctx  Monitor context
+ * \returns false if there is no store or nothing has been saved
+ */
+bool storeRestore(mon_ctx_t* ctx)
+{
+	if (flashPage(0) == NULL)
+		return false;
+	scan(ctx);
+	return active >= 0;
+}
+
+/**
+ * \brief Save the registers and settings, appending records only for
+ * those that have changed and compacting when the page is full.
+ * \param ctx  Monitor context
+ * \returns false if there is no store or it can't be written
+ */
+bool storeSave(mon_ctx_t* ctx)
+{
+	unsigned char r[RECORD(MAX_STRING + 1)];
+
+	if (flashPage(0) == NULL)
+		return false;
+	if (!scanned)
+		scan(NULL);
+	if ((active < 0) || (end == STORE_PAGE_SIZE))
+		return compact(ctx);
+	for (int i=0; i<ITEMS; i++) {
+		unsigned n = record(ctx, i, r);
+		if (n == 0)
+			continue;
+		uint16_t crc = r[2 + r[1]] | (r[3 + r[1]] << 8);
+		// the CRC rules most items out, a match may still be a collision
+		if (have[i] && (saved[i] == crc) && !memcmp(flashPage(active) + at[i], r, n))
+			continue;
+		if (end + n > STORE_PAGE_SIZE)
+			return compact(ctx);
+		if (!flashWrite(active, end, r, n)) {
+			end = STORE_PAGE_SIZE;	// compact next time
+			return false;
+		}
+		have[i] = true;
+		saved[i] = crc;
+		at[i] = end;
+		end += n;
+	}
+	return true;
+}
+
+/**
+ * \brief Save the registers, prompt and output settings
+ * \param args  None
+ * \param nArgs  0
+ * \returns 'EMPTY' or 'ERR' token (must be freed)
+ */
+token_t* cmd_save(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	token_t* r = tokenAlloc(ctx, "cmd_save");
+	if (flashPage(0) == NULL)
+		return emitError(ctx, r, MSG_NO_STORE);
+	if (!storeSave(ctx))
+		return emitError(ctx, r, MSG_STORE);
+	r->t = EMPTY;
+	return r;
+}
+
+/**
+ * \brief Restore the registers, prompt and output settings last saved
+ * \param args  None
+ * \param nArgs  0
+ * \returns 'EMPTY' or 'ERR' token (must be freed)
+ */
+token_t* cmd_restore(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	token_t* r = tokenAlloc(ctx, "cmd_restore");
+	if (flashPage(0) == NULL)
+		return emitError(ctx, r, MSG_NO_STORE);
+	if (!storeRestore(ctx))
+		return emitError(ctx, r, MSG_NOTHING_SAVED);
+	r->t = EMPTY;
+	return r;
+}
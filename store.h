@@ -0,0 +1,43 @@
+/**
+ * \file store.h
+ * \brief Registers and settings kept in flash, a log of CRC'd records.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_STORE_H)
+#define _STORE_H
+
+#include "token.h"
+
+#define STORE_PAGES		2		//!< Flash pages used in turn, at least 2
+#define STORE_PAGE_SIZE	1024	//!< Bytes per page
+#define STORE_ALIGN		4		//!< Flash write unit, records are padded to it
+
+extern bool storeRestore(mon_ctx_t* ctx);
+extern bool storeSave(mon_ctx_t* ctx);
+
+extern token_t* cmd_save(mon_ctx_t* ctx, token_t *args[], int nArgs);
+extern token_t* cmd_restore(mon_ctx_t* ctx, token_t *args[], int nArgs);
+
+#endif
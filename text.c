@@ -0,0 +1,157 @@
+/**
+ * \file text.c
+ * \brief Help and message text, optionally byte pair packed.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "text.h"
+#include "context.h"
+#include "pgm.h"
+#include "main.h"
+
+#define TEXT_CHUNK	16		//!< Characters decoded per transmit()
+
+#ifdef INCL_PACK
+/*
+ * Generated by textpack into textdata.c. Codes below TEXT_PAIR are
+ * characters, code c from TEXT_PAIR up stands for the two codes in
+ * textPairs[c - TEXT_PAIR]. Text n is textData[textStart[n]] up to
+ * textData[textStart[n + 1]].
+ */
+extern const unsigned char textPairs[][2] PGM_SPACE;
+extern const unsigned short textStart[] PGM_SPACE;
+extern const unsigned char textData[] PGM_SPACE;
+#define TEXT_PAIR	128
+#else
+#define MSG(id, s)	static const char text_ ## id[] PGM_SPACE = s;
+MESSAGES
+#undef MSG
+#define MSG(id, s)	text_ ## id,
+static const char* const texts[MSG_COUNT] PGM_SPACE = {
+	MESSAGES
+};
+#undef MSG
+#endif
+
+/**
+ * \brief Position in a text being decoded
+ */
+typedef struct {
+	const unsigned char* p;  //!< Next code in program memory
+#ifdef INCL_PACK
+	const unsigned char* end;  //!< End of the codes
+	unsigned char stack[TEXT_DEPTH];  //!< Second halves of pairs still to send
+	unsigned char top;  //!< Entries in stack
+#endif
+} textPos_t;
+
+/**
+ * \brief Start decoding a text
+ * \param pos  Position to set
+ * \param id  Message number (MSG_*), or with INCL_PACK MSG_COUNT plus a
+ * command's index for its help
+ */
+static void textOpen(textPos_t* pos, unsigned id)
+{
+#ifdef INCL_PACK
+	unsigned short range[2];
+	pgmCopy(range, &textStart[id], sizeof(range));
+	pos->p = &textData[range[0]];
+	pos->end = &textData[range[1]];
+	pos->top = 0;
+#else
+	pgmCopy(&pos->p, &texts[id], sizeof(pos->p));
+#endif
+}
+
+/**
+ * \brief Next character of a text
+ * \param pos  Position, advanced
+ * \returns The character, or 0 at the end
+ */
+static char textNext(textPos_t* pos)
+{
+#ifdef INCL_PACK
+	unsigned char c;
+	if (pos->top > 0)
+		c = pos->stack[--pos->top];
+	else if (pos->p < pos->end)
+		c = pgmByte(pos->p++);
+	else
+		return 0;
+	while (c >= TEXT_PAIR) {
+		unsigned char pair[2];
+		pgmCopy(pair, textPairs[c - TEXT_PAIR], 2);
+		pos->stack[pos->top++] = pair[1];
+		c = pair[0];
+	}
+	return c;
+#else
+	return pgmByte(pos->p++);
+#endif
+}
+
+/**
+ * \brief Send a message or help text, decoding it as it goes
+ * \param id  Message number (MSG_*), or with INCL_PACK MSG_COUNT plus a
+ * command's index for its help
+ */
+void textEmit(mon_ctx_t* ctx, unsigned id)
+{
+	textPos_t pos;
+	char buf[TEXT_CHUNK];
+	unsigned n = 0;
+
+	textOpen(&pos, id);
+	while ((buf[n] = textNext(&pos)) != 0) {
+		if (++n == TEXT_CHUNK) {
+			transmit(ctx, buf, n);
+			n = 0;
+		}
+	}
+	if (n > 0)
+		transmit(ctx, buf, n);
+}
+
+/**
+ * \brief Copy a message into RAM, e.g. an ERR token's string
+ * \param dst  Destination
+ * \param id  Message number (MSG_*)
+ * \param size  Size of dst, the copy is cut to fit and always terminated
+ * \returns dst
+ */
+char* textCopy(char* dst, unsigned id, unsigned size)
+{
+	textPos_t pos;
+	unsigned n = 0;
+
+	textOpen(&pos, id);
+	while ((n < size - 1) && ((dst[n] = textNext(&pos)) != 0))
+		n++;
+	dst[n] = 0;
+	return dst;
+}
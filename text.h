@@ -0,0 +1,80 @@
+/**
+ * \file text.h
+ * \brief Help and message text, optionally byte pair packed.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_TEXT_H)
+#define _TEXT_H
+
+#include "token.h"
+
+#define TEXT_DEPTH	8	//!< Most nesting of pairs, the decoder's stack size
+
+/**
+ * \brief The messages, in the order of their numbers. The text packer
+ * (textpack.c) reads this list from the preprocessed source.
+ */
+#define MESSAGES \
+	MSG(ARGUMENT, "Argument Error") \
+	MSG(NOT_FOUND, "Command Not Found") \
+	MSG(RANGE, "Number Out Of Range") \
+	MSG(NEST, "Nesting Too Deep") \
+	MSG(POOL, "Token pool empty") \
+	MSG(EXPR, "Expression Error") \
+	MSG(DIV_ZERO, "Divide By Zero") \
+	MSG(EXPR_DEEP, "Expression Too Deep") \
+	MSG(WATCH, "Watch Error") \
+	MSG(NO_WATCH, "Watch Not Found") \
+	MSG(NO_PAINT, "Stack Not Painted") \
+	MSG(CANCELLED, "Cancelled") \
+	MSG(MEMORY, "Memory Error") \
+	MSG(NO_TIMER, "No Profile Timer") \
+	MSG(NO_STORE, "No Store") \
+	MSG(STORE, "Store Error") \
+	MSG(NOTHING_SAVED, "Nothing Saved") \
+	MSG(OPEN, "# ") \
+	MSG(CLOSE, " #") \
+	MSG(REGISTER, "Register '") \
+	MSG(REG_RANGE, "' out of range") \
+	MSG(REG_UNDEFINED, "' undefined") \
+	MSG(AT, " at ")
+
+#if defined(TEXT_SCAN)
+#define MSG(id, s)	TEXT_MSG s
+MESSAGES
+#undef MSG
+#else
+#define MSG(id, s)	MSG_ ## id,
+enum {
+	MESSAGES
+	MSG_COUNT  //!< Number of messages, help text follows with INCL_PACK
+};
+#undef MSG
+#endif
+
+extern void textEmit(mon_ctx_t* ctx, unsigned id);
+extern char* textCopy(char* dst, unsigned id, unsigned size);
+
+#endif
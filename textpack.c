@@ -0,0 +1,237 @@
+/**
+ * \file textpack.c
+ * \brief Packs the help and message text with byte pair encoding.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "text.h"
+
+#define MAX_TEXTS	256		//!< Most messages plus commands
+#define MAX_LEN		128		//!< Longest text
+#define PAIR		128		//!< First pair code, codes below are characters
+#define MAX_PAIRS	128		//!< Pair codes that fit in a byte
+
+static unsigned char codes[MAX_TEXTS][MAX_LEN];  //!< Each text's codes
+static unsigned lens[MAX_TEXTS];  //!< Codes in each text
+static char plain[MAX_TEXTS][MAX_LEN];  //!< Each text, to check the packing
+static unsigned numTexts;
+static unsigned char pairs[MAX_PAIRS][2];
+static unsigned char depth[PAIR + MAX_PAIRS];  //!< Nesting of each code
+static unsigned numPairs;
+
+/**
+ * \brief Add the text of the string literals at p
+ * \param p  First literal, adjacent literals are joined
+ * \returns End of the literals
+ */
+static const char* addText(const char* p)
+{
+	unsigned n = 0;
+	while (*p == '"') {
+		for (p++; (*p != '"') && (*p != 0); p++) {
+			char c = *p;
+			if ((c == '\\') && (p[1] != 0)) {
+				c = *++p;
+				if (c == 'n')
+					c = '\n';
+				else if (c == 't')
+					c = '\t';
+			}
+			if ((c & 0x80) || (n >= MAX_LEN - 1)) {
+				fprintf(stderr, "textpack: text %u too long or not ASCII\n", numTexts);
+				exit(1);
+			}
+			codes[numTexts][n] = c;
+			plain[numTexts][n++] = c;
+		}
+		if (*p == '"')
+			p++;
+		p += strspn(p, " \t\n");
+	}
+	lens[numTexts++] = n;
+	return p;
+}
+
+/**
+ * \brief Collect the texts after each 'key' in the source, in order
+ * \param src  Preprocessed source
+ * \param key  TEXT_MSG or TEXT_CMD
+ */
+static void collect(const char* src, const char* key)
+{
+	size_t len = strlen(key);
+	for (const char* p = strstr(src, key); p != NULL; p = strstr(p, key)) {
+		p += len;
+		p += strspn(p, " \t\n");
+		if (*p != '"')
+			continue;
+		if (numTexts == MAX_TEXTS) {
+			fprintf(stderr, "textpack: too many texts\n");
+			exit(1);
+		}
+		p = addText(p);
+	}
+}
+
+/**
+ * \brief Replace the commonest pair of codes with a new code, while that
+ * saves more than the two bytes the pair costs.
+ * \returns false when no pair is worth it
+ */
+static bool addPair()
+{
+	static unsigned count[PAIR + MAX_PAIRS][PAIR + MAX_PAIRS];
+	unsigned best = 0, a = 0, b = 0;
+
+	if (numPairs == MAX_PAIRS)
+		return false;
+	memset(count, 0, sizeof(count));
+	for (unsigned t=0; t<numTexts; t++) {
+		for (unsigned i=0; i+1<lens[t]; i++) {
+			unsigned x = codes[t][i], y = codes[t][i+1];
+			unsigned d = (depth[x] > depth[y]) ? depth[x] : depth[y];
+			if (d >= TEXT_DEPTH)
+				continue;
+			// don't count overlapping runs like 'aaa' twice
+			if ((i > 0) && (x == y) && (codes[t][i-1] == x))
+				continue;
+			if (++count[x][y] > best) {
+				best = count[x][y];
+				a = x;
+				b = y;
+			}
+		}
+	}
+	if (best < 3)
+		return false;
+
+	unsigned c = PAIR + numPairs;
+	pairs[numPairs][0] = a;
+	pairs[numPairs++][1] = b;
+	depth[c] = 1 + ((depth[a] > depth[b]) ? depth[a] : depth[b]);
+	for (unsigned t=0; t<numTexts; t++) {
+		unsigned j = 0;
+		for (unsigned i=0; i<lens[t]; i++) {
+			if ((i + 1 < lens[t]) && (codes[t][i] == a) && (codes[t][i+1] == b)) {
+				codes[t][j++] = c;
+				i++;
+			} else
+				codes[t][j++] = codes[t][i];
+		}
+		lens[t] = j;
+	}
+	return true;
+}
+
+/**
+ * \brief Expand a code as the monitor's decoder does
+ * \param c  Code
+ * \param out  Text so far
+ * \param n  Characters in out, advanced
+ */
+static void expand(unsigned c, char* out, unsigned* n)
+{
+	if (c < PAIR)
+		out[(*n)++] = c;
+	else {
+		expand(pairs[c - PAIR][0], out, n);
+		expand(pairs[c - PAIR][1], out, n);
+	}
+}
+
+/**
+ * \brief Read the preprocessed commands.c on stdin and write textdata.c
+ * on stdout: the messages from the MESSAGES list (text.h), then the help
+ * of each command in the dispatch table, packed with byte pair encoding.
+ * The sizes go to stderr.
+ */
+int main(int argc, char* argv[])
+{
+	size_t size = 0, len = 0;
+	char* src = NULL;
+	int c;
+
+	while ((c = getchar()) != EOF) {
+		if (len + 1 >= size)
+			src = realloc(src, size = size * 2 + 4096);
+		src[len++] = c;
+	}
+	if (src == NULL)
+		return 1;
+	src[len] = 0;
+	collect(src, "TEXT_MSG");
+	unsigned numMsgs = numTexts;
+	collect(src, "TEXT_CMD");
+	if ((numMsgs == 0) || (numTexts == numMsgs)) {
+		fprintf(stderr, "textpack: no messages or no help found\n");
+		return 1;
+	}
+
+	unsigned before = 0, after = 0;
+	for (unsigned t=0; t<numTexts; t++)
+		before += lens[t] + 1;
+	while (addPair())
+		;
+	for (unsigned t=0; t<numTexts; t++) {
+		char out[MAX_LEN];
+		unsigned n = 0;
+		for (unsigned i=0; i<lens[t]; i++)
+			expand(codes[t][i], out, &n);
+		if ((n != strlen(plain[t])) || memcmp(out, plain[t], n)) {
+			fprintf(stderr, "textpack: text %u does not unpack\n", t);
+			return 1;
+		}
+		after += lens[t];
+	}
+
+	printf("/* Generated by textpack from the preprocessed commands.c, do not edit */\n\n");
+	printf("#include \"pgm.h\"\n\n");
+	printf("const unsigned char textPairs[%u][2] PGM_SPACE = {", numPairs ? numPairs : 1);
+	for (unsigned i=0; i<numPairs; i++)
+		printf("%s{%u,%u},", (i % 8) ? "" : "\n\t", pairs[i][0], pairs[i][1]);
+	printf("%s\n};\n\n", numPairs ? "" : "{0,0}");
+	printf("const unsigned short textStart[%u] PGM_SPACE = {", numTexts + 1);
+	for (unsigned t=0, at=0; t<=numTexts; t++) {
+		printf("%s%u,", (t % 12) ? "" : "\n\t", at);
+		if (t < numTexts)
+			at += lens[t];
+	}
+	printf("\n};\n\n");
+	printf("const unsigned char textData[%u] PGM_SPACE = {", after);
+	for (unsigned t=0, k=0; t<numTexts; t++)
+		for (unsigned i=0; i<lens[t]; i++, k++)
+			printf("%s%u,", (k % 16) ? "" : "\n\t", codes[t][i]);
+	printf("\n};\n");
+
+	unsigned packed = after + numPairs * 2 + (numTexts + 1) * 2;
+	fprintf(stderr, "textpack: %u messages and %u help texts, %u bytes packed to %u"
+			" (%u pairs, %u start offsets)\n", numMsgs, numTexts - numMsgs,
+			before, packed, numPairs, numTexts + 1);
+	return 0;
+}
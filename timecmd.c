@@ -0,0 +1,152 @@
+/**
+ * \file timecmd.c
+ * \brief Measure the cost of a command.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "timecmd.h"
+#include "context.h"
+#include "process.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+/**
+ * \brief Start a timed section
+ * \returns Start time for timeEnd
+ */
+unsigned long timeBegin(mon_ctx_t* ctx)
+{
+	ctx->time.depth++;
+	return clockMicros();
+}
+
+/**
+ * \brief End a timed section, adding its time to a total if it is not
+ * inside another timed section
+ * \param total  Total to add to
+ * \param t0  Value returned by timeBegin
+ */
+void timeEnd(mon_ctx_t* ctx, unsigned long* total, unsigned long t0)
+{
+	if (--ctx->time.depth == 0)
+		*total += clockMicros() - t0;
+}
+
+/**
+ * \brief Print a label and a number
+ * \param label  Text before the number
+ * \param n  Number
+ */
+static void report(mon_ctx_t* ctx, char* label, unsigned long n)
+{
+	emitStr(ctx, label, strlen(label));
+	emitUnsigned(ctx, n, 0);
+}
+
+/**
+ * \brief Run a command and report what it cost
+ * \param args  Array of optional 'NUM' number of runs and the command
+ * \param nArgs  Number of arguments, one or two
+ * \returns The result of the last run (must be freed)
+ */
+token_t* cmd_time(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	unsigned long runs[TIME_MAX_RUNS];  // on the stack, a nested time has its own
+	int n = 1;
+	token_t* r = NULL;
+
+	if ((nArgs > 2) || ((nArgs == 2) && (args[0]->t != NUM))) {
+		r = tokenAlloc(ctx, "cmd_time");
+		return emitError(ctx, r, MSG_ARGUMENT);
+	}
+	if (nArgs == 2) {
+		// check the whole number, it may be wider than an int
+		if ((args[0]->v.d < 1) || (args[0]->v.d > TIME_MAX_RUNS)) {
+			r = tokenAlloc(ctx, "cmd_time");
+			return emitError(ctx, r, MSG_RANGE);
+		}
+		n = args[0]->v.d;
+	}
+	char cmd[MAX_STRING];
+	char buf[FORMAT_LEN];
+	strncpy(cmd, tokenGetText(ctx, args[nArgs-1], buf), MAX_STRING-1);
+	cmd[MAX_STRING-1] = 0;
+
+	// time the command as if it were not nested in this one
+	int depth = ctx->time.depth;
+	ctx->time.depth = 0;
+	timeStats_t before = ctx->time;
+	int i;
+	for (i=0; i<n; i++) {
+		if (r != NULL)
+			tokenFree(ctx, r);
+		unsigned long t0 = clockMicros();
+		r = eval(ctx, cmd);
+		runs[i] = clockMicros() - t0;
+		if (r == NULL)
+			break;
+	}
+	if (i < n)
+		n = i + 1;
+	ctx->time.depth = depth;
+
+	// sort the run times for the median
+	unsigned long total = 0;
+	for (i=0; i<n; i++) {
+		unsigned long t = runs[i];
+		int j;
+		for (j=i; (j>0) && (runs[j-1] > t); j--)
+			runs[j] = runs[j-1];
+		runs[j] = t;
+		total += t;
+	}
+	unsigned long lex = (ctx->time.lex - before.lex) / n;
+	unsigned long handler = (ctx->time.handler - before.handler) / n;
+	unsigned long tokens = (ctx->time.tokens - before.tokens) / n;
+	unsigned long tx = (ctx->time.tx - before.tx) / n;
+	if (n == 1) {
+		report(ctx, "elapsed ", runs[0]);
+	} else {
+		report(ctx, "elapsed min ", runs[0]);
+		report(ctx, " median ", runs[n/2]);
+		report(ctx, " max ", runs[n-1]);
+	}
+	report(ctx, " us: lex ", lex);
+	report(ctx, ", dispatch ", (total/n > lex + handler) ? total/n - lex - handler : 0);
+	report(ctx, ", handler ", handler);
+	report(ctx, EOL "tokens ", tokens);
+	report(ctx, ", tx ", tx);
+	emitPgmString(ctx, " bytes" EOL);
+
+	if (r == NULL) {
+		r = tokenAlloc(ctx, "cmd_time");
+		r->t = EMPTY;
+	}
+	return r;
+}
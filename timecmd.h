@@ -0,0 +1,71 @@
+/**
+ * \file timecmd.h
+ * \brief Measure the cost of a command.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_TIMECMD_H)
+#define _TIMECMD_H
+
+#include "token.h"
+
+/**
+ * Most runs of one 'time' command. The run times are on the stack, once
+ * per nested 'time', so small targets keep fewer.
+ */
+#ifdef BIG
+#define TIME_MAX_RUNS	32
+#else
+#define TIME_MAX_RUNS	8
+#endif
+
+/**
+ * \brief Running totals kept in the monitor context, the difference before
+ * and after a command is its cost. Ports add the size of each transmit()
+ * to 'tx' with TIME_COUNT.
+ */
+typedef struct {
+	unsigned long lex;  //!< Microseconds in the lexer
+	unsigned long handler;  //!< Microseconds in command functions
+	unsigned long tokens;  //!< Tokens allocated
+	unsigned long tx;  //!< Bytes transmitted
+	int depth;  //!< Nesting of timed sections, only the outermost counts
+} timeStats_t;
+
+#ifdef INCL_TIME
+#define TIME_BEGIN(C, v)		unsigned long v = timeBegin(C)
+#define TIME_END(C, total, v)	timeEnd(C, &(C)->time.total, v)
+#define TIME_COUNT(C, total, n)	(C)->time.total += n
+#else
+#define TIME_BEGIN(C, v)
+#define TIME_END(C, total, v)
+#define TIME_COUNT(C, total, n)
+#endif
+
+extern unsigned long timeBegin(mon_ctx_t* ctx);
+extern void timeEnd(mon_ctx_t* ctx, unsigned long* total, unsigned long t0);
+
+extern token_t* cmd_time(mon_ctx_t* ctx, token_t *args[], int nArgs);
+
+#endif
@@ -0,0 +1,191 @@
+/**
+ * \file timer.c
+ * \brief Periodic software timers on a timer wheel.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "timer.h"
+
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define NONE		0		//!< End of a timer list, timers[0] is never used
+#define FIRING		-1		//!< Slot value of a timer on the firing list
+
+/**
+ * \brief Software timer
+ */
+typedef struct {
+	timerFunc_t func;  //!< Expiry function, NULL if the timer is free
+	void* arg;  //!< Argument for expiry function
+	unsigned period;  //!< Period in ticks
+	unsigned rounds;  //!< Remaining turns of the wheel before expiry
+	signed char slot;  //!< Wheel slot holding the timer, or FIRING
+	signed char next;  //!< Next timer in the same list
+} swTimer_t;
+
+static swTimer_t timers[MAX_TIMERS + 1];
+static signed char wheel[WHEEL_SIZE];
+static signed char firing = NONE;
+static unsigned cursor = 0;
+static volatile unsigned ticks = 0;
+static unsigned ticksDone = 0;
+
+/**
+ * \brief Remove a timer from a list
+ * \param head  Head of the list
+ * \param n  Timer number
+ */
+static void listRemove(signed char* head, int n)
+{
+	while (*head != NONE) {
+		if (*head == n) {
+			*head = timers[n].next;
+			return;
+		}
+		head = &timers[*head].next;
+	}
+}
+
+/**
+ * \brief Put a timer into the wheel slot that expires in 'delay' ticks
+ * \param n  Timer number
+ * \param delay  Ticks until expiry, at least one
+ */
+static void insert(int n, unsigned delay)
+{
+	int slot = (cursor + delay) & WHEEL_MASK;
+	timers[n].rounds = (delay - 1) >> WHEEL_BITS;
+	timers[n].slot = slot;
+	timers[n].next = wheel[slot];
+	wheel[slot] = n;
+}
+
+/**
+ * \brief Start a periodic timer
+ * \param period  Period in ticks (TIMER_TICK_MS each)
+ * \param func  Function called each time the timer expires
+ * \param arg  Argument passed to func
+ * \returns Timer handle, or -1 if there are no free timers
+ */
+int timerStart(unsigned period, timerFunc_t func, void* arg)
+{
+	if (period == 0)
+		period = 1;
+	for (int i=1; i<=MAX_TIMERS; i++) {
+		if (timers[i].func == NULL) {
+			timers[i].func = func;
+			timers[i].arg = arg;
+			timers[i].period = period;
+			insert(i, period);
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * \brief Stop a timer, safe to call from an expiry function
+ * \param handle  Handle returned by timerStart
+ */
+void timerCancel(int handle)
+{
+	if ((handle < 1) || (handle > MAX_TIMERS) || (timers[handle].func == NULL))
+		return;
+	if (timers[handle].slot == FIRING)
+		listRemove(&firing, handle);
+	else
+		listRemove(&wheel[timers[handle].slot], handle);
+	timers[handle].func = NULL;
+}
+
+/**
+ * \brief Count one tick, may be called from an interrupt.
+ */
+void timerTick()
+{
+	ticks++;
+}
+
+/**
+ * \brief Advance the wheel by the ticks counted since the last call and
+ * run the expiry functions of timers that are due.
+ * \note Call from the main loop, not from an interrupt.
+ */
+void timerPoll()
+{
+	while (ticksDone != ticks) {
+		ticksDone++;
+		cursor = (cursor + 1) & WHEEL_MASK;
+		// Move due timers onto the firing list
+		signed char* p = &wheel[cursor];
+		while (*p != NONE) {
+			int n = *p;
+			if (timers[n].rounds > 0) {
+				timers[n].rounds--;
+				p = &timers[n].next;
+			} else {
+				*p = timers[n].next;
+				timers[n].slot = FIRING;
+				timers[n].next = firing;
+				firing = n;
+			}
+		}
+		// Reschedule then call each, the call may cancel any timer
+		while (firing != NONE) {
+			int n = firing;
+			firing = timers[n].next;
+			insert(n, timers[n].period);
+			timers[n].func(timers[n].arg);
+		}
+	}
+}
+
+/**
+ * \brief Ticks until the next timer is due, so an idle main loop can
+ * sleep rather than count ticks that have nothing to do.
+ * \returns Ticks until the earliest expiry, 0 if timers are due now, or
+ * -1 if no timer is running
+ */
+int timerNext()
+{
+	unsigned pending = ticks - ticksDone;
+	int next = -1;
+	for (int i=1; i<=MAX_TIMERS; i++) {
+		if (timers[i].func == NULL)
+			continue;
+		if (timers[i].slot == FIRING)
+			return 0;
+		unsigned d = (timers[i].slot - cursor) & WHEEL_MASK;
+		if (d == 0)
+			d = WHEEL_SIZE;
+		d += timers[i].rounds << WHEEL_BITS;
+		d = (d > pending) ? d - pending : 0;
+		if ((next < 0) || (d < next))
+			next = d;
+	}
+	return next;
+}
@@ -0,0 +1,47 @@
+/**
+ * \file timer.h
+ * \brief Periodic software timers on a timer wheel.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_TIMER_H)
+#define _TIMER_H
+
+#define TIMER_TICK_MS	1	//!< Period of timerTick() calls in milliseconds
+#define MAX_TIMERS		8	//!< Number of software timers
+#define WHEEL_BITS		4	//!< log2 of number of wheel slots
+
+/**
+ * \brief Timer expiry function, called from timerPoll()
+ */
+typedef void (*timerFunc_t)(void* arg);
+
+extern int timerStart(unsigned period, timerFunc_t func, void* arg);
+extern void timerCancel(int handle);
+
+extern void timerTick();
+extern void timerPoll();
+extern int timerNext();
+
+#endif
@@ -29,35 +29,43 @@
 #include <string.h>
 
 #include "token.h"
+#include "context.h"
+#include "emit.h"
+#include "text.h"
 #include "main.h"
 #include "print.h"
+#include "timecmd.h"
+#include "prof.h"
+#include "trace.h"
 
 #if BIG
 #include <stdio.h>
 #endif
 
-bool outputDecimal = true;
-
-#define MAX_TOKENS	20
-static token_t pool[MAX_TOKENS];
-static bool inUse[MAX_TOKENS];
-static char* owners[MAX_TOKENS];
-
 /**
  * Allocate token.
+ * \param ctx  Monitor context, tokens come from its pool.
  * \param owner  Name of allocator (for debugging).
  * \returns  Fresh token.
  */
-token_t* tokenAlloc(char *owner)
+token_t* tokenAlloc(mon_ctx_t* ctx, char *owner)
 {
+	PROF_ENTER(PROF_TOKEN, p0);
 	for (int i=0; i<MAX_TOKENS; i++) {
-		if (!inUse[i]) {
-			inUse[i] = true;
-			owners[i] = owner;
-			return &pool[i];
+		if (!ctx->inUse[i]) {
+			ctx->inUse[i] = true;
+			ctx->owners[i] = owner;
+			TIME_COUNT(ctx, tokens, 1);
+			TRACE(TRACE_ALLOC, i);
+			PROF_LEAVE(p0);
+			return &ctx->pool[i];
 		}
 	}
-	transmitString("# Token pool empty #" EOL);
+	TRACE(TRACE_POOL_EMPTY, 0);
+	PROF_LEAVE(p0);
+	emitErrorOpen(ctx);
+	textEmit(ctx, MSG_POOL);
+	emitErrorClose(ctx);
 	return NULL;
 }
 
@@ -67,9 +75,9 @@ token_t* tokenAlloc(char *owner)
  * \param owner  Name of allocator (for debugging).
  * \returns  Copy of existing token.
  */
-token_t* tokenDup(token_t* token, char *owner)
+token_t* tokenDup(mon_ctx_t* ctx, token_t* token, char *owner)
 {
-	token_t* newToken = tokenAlloc(owner);
+	token_t* newToken = tokenAlloc(ctx, owner);
 	memcpy(newToken, token, sizeof(token_t));
 	return newToken;
 }
@@ -78,39 +86,52 @@ token_t* tokenDup(token_t* token, char *owner)
  * Free token
  * \param t  Token to be freed.
  */
-void tokenFree(token_t* t)
+void tokenFree(mon_ctx_t* ctx, token_t* t)
 {
 	for (int i=0; i<MAX_TOKENS; i++)
-		if (t == &pool[i]) {
+		if (t == &ctx->pool[i]) {
 #if BIG
-			if (!inUse[i])
+			if (!ctx->inUse[i])
 				printf("# free token %d freed#\n", i);
 #endif
-			inUse[i] = false;
+			TRACE(TRACE_FREE, i);
+			ctx->inUse[i] = false;
 		}
 }
 
-static char outBuf[2];
+/**
+ * Count unallocated tokens
+ * \returns  Number of tokens free in the pool.
+ */
+int tokensFree(mon_ctx_t* ctx)
+{
+	int n = 0;
+	for (int i=0; i<MAX_TOKENS; i++)
+		if (!ctx->inUse[i])
+			n++;
+	return n;
+}
 
 /**
  * Get string describing token contents
  * \param token  The token to describe.
- * \returns String describing token contents
+ * \param buf  FORMAT_LEN characters for the text of a number or register
+ * \returns String describing token contents, in the token or buf
  */
-char* tokenGetText(token_t* token)
+char* tokenGetText(mon_ctx_t* ctx, token_t* token, char* buf)
 {
 	if (token->t == STR)
 		return token->v.s;
 	if (token->t == NUM)
-		return formatNum(token->v.d, outputDecimal);
+		return formatNum(buf, token->v.d, ctx->outputDecimal);
 #ifdef INCL_REG
 	if (token->t == REG) {
-		outBuf[0] = token->v.c;
-		outBuf[1] = 0;
+		buf[0] = token->v.c;
+		buf[1] = 0;
 	} else
 #endif
-		outBuf[0] = 0;
-	return outBuf;
+		buf[0] = 0;
+	return buf;
 }
 
 
@@ -125,12 +146,15 @@ void tokenDebug(char* prefix, token_t* t)
 	switch (t->t) {
 	case ERR: printf("%s  ERR: %s\n", prefix, t->v.s); break;
 	case STR: printf("%s  STR: \"%s\"\n", prefix, t->v.s); break;
-	case NUM: printf("%s  NUM: %d\n", prefix, t->v.d); break;
+	case NUM: printf("%s  NUM: %lld\n", prefix, (long long)t->v.d); break;
 #ifdef INCL_REG
 	case REG: printf("%s  REG: %c\n", prefix, t->v.c); break;
 	case GET: printf("%s  GET: %c\n", prefix, t->v.c); break;
 #endif
 	case EXE: printf("%s  EXE\n", prefix); break;
+#ifdef INCL_EXPR
+	case EXPR: printf("%s  EXPR: %s\n", prefix, t->v.s); break;
+#endif
 	case EMPTY: printf("%s  EMPTY\n", prefix); break;
 	case END: printf("%s  END\n", prefix); break;
 #ifdef INCL_EXIT
@@ -142,13 +166,13 @@ void tokenDebug(char* prefix, token_t* t)
 /**
  * Print report on token usage.
  */
-void tokenReport()
+void tokenReport(mon_ctx_t* ctx)
 {
 	int cnt = 0;
 	for (int i=0; i<MAX_TOKENS; i++) {
-		if (inUse[i]) {
-			printf("token %d in use by \"%s\"", i, owners[i]);
-			tokenDebug("", &pool[i]);
+		if (ctx->inUse[i]) {
+			printf("token %d in use by \"%s\"", i, ctx->owners[i]);
+			tokenDebug("", &ctx->pool[i]);
 			cnt++;
 		}
 	}
@@ -29,9 +29,42 @@
 #define _TOKEN_POOL
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define MAX_STRING 32
 
+/*
+ * Width of numbers, select with -DNUM_BITS=16, 32 or 64. 16 suits 8 bit
+ * MCUs, 64 holds timestamps and addresses on 32 bit ones.
+ */
+#if !defined(NUM_BITS)
+#define NUM_BITS	32
+#endif
+#if NUM_BITS == 16
+typedef int16_t num_t;  //!< Number
+typedef uint16_t unum_t;  //!< Unsigned number of the same width
+#define NUM_MAX		INT16_MAX
+#define UNUM_MAX	UINT16_MAX
+#elif NUM_BITS == 32
+typedef int32_t num_t;
+typedef uint32_t unum_t;
+#define NUM_MAX		INT32_MAX
+#define UNUM_MAX	UINT32_MAX
+#elif NUM_BITS == 64
+typedef int64_t num_t;
+typedef uint64_t unum_t;
+#define NUM_MAX		INT64_MAX
+#define UNUM_MAX	UINT64_MAX
+#else
+#error NUM_BITS must be 16, 32 or 64
+#endif
+#define MAX_TOKENS	20
+
+/**
+ * \brief Monitor context, see context.h
+ */
+typedef struct mon_ctx mon_ctx_t;
+
 /**
  * \brief Type of token
  */
@@ -44,6 +77,9 @@ typedef enum {
 	GET,   /**< Get token, value is register name. */
 #endif
 	EXE,   /**< Execute token, no value. */
+#ifdef INCL_EXPR
+	EXPR,   /**< Expression token, value is the expression's text. */
+#endif
 	EMPTY,   /**< Empty token, no value. */
 	END,   /**< End of input token, no value. */
 #ifdef INCL_EXIT
@@ -61,18 +97,17 @@ typedef struct {
 #ifdef INCL_REG
 		char c;  //!< Register (name) value
 #endif
-		int  d;  //!< Numeric value
+		num_t d;  //!< Numeric value
 	} v;  //!< token value
 } token_t;
 
-extern bool outputDecimal;
-
-extern token_t* tokenAlloc(char *owner);
-extern token_t* tokenDup(token_t* token, char *owner);
-extern void tokenFree(token_t* t);
-extern char* tokenGetText(token_t* token);
+extern token_t* tokenAlloc(mon_ctx_t* ctx, char *owner);
+extern token_t* tokenDup(mon_ctx_t* ctx, token_t* token, char *owner);
+extern void tokenFree(mon_ctx_t* ctx, token_t* t);
+extern int tokensFree(mon_ctx_t* ctx);
+extern char* tokenGetText(mon_ctx_t* ctx, token_t* token, char* buf);
 
 extern void tokenDebug(char* prefix, token_t* t);
-extern void tokenReport();
+extern void tokenReport(mon_ctx_t* ctx);
 
 #endif
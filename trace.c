@@ -0,0 +1,103 @@
+/**
+ * \file trace.c
+ * \brief Binary event trace in a ring buffer.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "trace.h"
+#include "context.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+static traceRec_t ring[TRACE_SIZE];
+static unsigned written = 0;  //!< Records ever written, the next goes at written % TRACE_SIZE
+
+/**
+ * \brief Write a trace record, overwriting the oldest when the ring is full
+ * \param id  Trace point
+ * \param arg  Its argument
+ */
+void traceAdd(unsigned id, unsigned arg)
+{
+	traceRec_t* r = &ring[written++ & (TRACE_SIZE - 1)];
+	r->time = clockMicros();
+	r->arg = arg;
+	r->id = id;
+}
+
+/**
+ * \brief Send the ring, oldest first, as a header line with the number of
+ * records sent and written then lines of TRACE_PER_LINE records, each 14
+ * hex digits. aMonTrace turns it into a timeline.
+ */
+static void dump(mon_ctx_t* ctx)
+{
+	unsigned end = written;
+	unsigned n = (end < TRACE_SIZE) ? end : TRACE_SIZE;
+
+	emitString(ctx, "trace ");
+	emitUnsigned(ctx, n, 0);
+	emitString(ctx, " of ");
+	emitUnsigned(ctx, end, 0);
+	for (unsigned i=0; i<n; i++) {
+		traceRec_t* r = &ring[(end - n + i) & (TRACE_SIZE - 1)];
+		if (i % TRACE_PER_LINE == 0)
+			emitString(ctx, EOL "t");
+		emitHex(ctx, r->id, false, 2);
+		emitHex(ctx, r->arg, false, 4);
+		// in halves, unum_t may be 16 bits
+		emitHex(ctx, r->time >> 16, false, 4);
+		emitHex(ctx, r->time & 0xFFFF, false, 4);
+	}
+	emitString(ctx, EOL);
+}
+
+/**
+ * \brief Dump or clear the trace of the monitor's recent steps, e.g.
+ * after "Token pool empty" to see how it got there.
+ * \param args  'dump' or 'clear'
+ * \param nArgs  1
+ * \returns 'EMPTY' or 'ERR' token (must be freed)
+ */
+token_t* cmd_trace(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	token_t* r = tokenAlloc(ctx, "cmd_trace");
+	char buf[FORMAT_LEN];
+	char* s = tokenGetText(ctx, args[0], buf);
+	r->t = EMPTY;
+
+	if (!strcmp(s, "dump"))
+		dump(ctx);
+	else if (!strcmp(s, "clear"))
+		written = 0;
+	else {
+		emitError(ctx, r, MSG_ARGUMENT);
+	}
+	return r;
+}
@@ -0,0 +1,78 @@
+/**
+ * \file trace.h
+ * \brief Binary event trace in a ring buffer.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(_TRACE_H)
+#define _TRACE_H
+
+#include <stdint.h>
+
+#include "token.h"
+
+#define TRACE_SIZE		64		//!< Records kept, a power of 2
+#define TRACE_PER_LINE	4		//!< Records per line of 'trace dump'
+
+/**
+ * \brief Trace point, what its argument holds is in brackets
+ */
+enum {
+	TRACE_EVAL = 1,  //!< eval() starts (nesting depth)
+	TRACE_EVAL_END,  //!< eval() returns (result type, 0xFFFF on exit)
+	TRACE_LEX_START,  //!< lexerStart() (suspended lexers)
+	TRACE_LEX_CLOSE,  //!< lexerClose() (suspended lexers)
+	TRACE_COMMAND,  //!< command() (table index, 0xFFFF if not found)
+	TRACE_ALLOC,  //!< tokenAlloc() (pool index)
+	TRACE_FREE,  //!< tokenFree() (pool index)
+	TRACE_POOL_EMPTY,  //!< tokenAlloc() failed
+	TRACE_SET_REG,  //!< setReg() (type << 8 | register)
+	TRACE_EVENTS
+};
+
+//! Names of the trace points for a decoder, in the order above
+#define TRACE_NAMES	{ "?", "eval", "eval end", "lex start", "lex close", \
+	"command", "alloc", "free", "pool empty", "set reg" }
+
+/**
+ * \brief Trace record, 'trace dump' sends each as 14 hex digits, id,
+ * arg then time
+ */
+typedef struct {
+	uint32_t time;  //!< clockMicros() when it was written
+	uint16_t arg;  //!< Trace point's argument
+	uint8_t id;  //!< Trace point
+} traceRec_t;
+
+#ifdef INCL_TRACE
+#define TRACE(id, arg)	traceAdd(id, arg)
+#else
+#define TRACE(id, arg)
+#endif
+
+extern void traceAdd(unsigned id, unsigned arg);
+
+extern token_t* cmd_trace(mon_ctx_t* ctx, token_t *args[], int nArgs);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * \file tracedec.c
+ * \brief Decode a 'trace dump' into a timeline.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace.h"
+
+static const char* const names[TRACE_EVENTS] = TRACE_NAMES;
+
+/**
+ * \brief Name of a token type, as built with the same flags as the monitor
+ * \param t  Token type
+ * \returns The name
+ */
+static const char* typeName(unsigned t)
+{
+	switch (t) {
+	case ERR: return "ERR";
+	case STR: return "STR";
+	case NUM: return "NUM";
+#ifdef INCL_REG
+	case REG: return "REG";
+	case GET: return "GET";
+#endif
+	case EXE: return "EXE";
+#ifdef INCL_EXPR
+	case EXPR: return "EXPR";
+#endif
+	case EMPTY: return "EMPTY";
+	case END: return "END";
+#ifdef INCL_EXIT
+	case EXIT: return "EXIT";
+#endif
+	case 0xFFFF: return "exit";
+	}
+	return "?";
+}
+
+/**
+ * \brief Value of some hex digits
+ * \param p  The digits
+ * \param n  How many
+ * \returns The value
+ */
+static uint32_t hex(const char* p, int n)
+{
+	char s[9];
+	memcpy(s, p, n);
+	s[n] = 0;
+	return strtoul(s, NULL, 16);
+}
+
+/**
+ * \brief Print one record of the timeline
+ * \param r  The record
+ * \param t0  Time of the first record
+ * \param prev  Time of the record before
+ */
+static void print(const traceRec_t* r, uint32_t t0, uint32_t prev)
+{
+	printf("%10lu us %+7ld  %-10s ", (unsigned long)(uint32_t)(r->time - t0),
+		(long)(uint32_t)(r->time - prev), (r->id < TRACE_EVENTS) ? names[r->id] : "?");
+	switch (r->id) {
+	case TRACE_EVAL:
+		printf("depth %u", r->arg);
+		break;
+	case TRACE_EVAL_END:
+		printf("%s", typeName(r->arg));
+		break;
+	case TRACE_LEX_START:
+	case TRACE_LEX_CLOSE:
+		printf("level %u", r->arg);
+		break;
+	case TRACE_COMMAND:
+		if (r->arg == 0xFFFF)
+			printf("not found");
+		else
+			printf("#%u", r->arg);
+		break;
+	case TRACE_ALLOC:
+	case TRACE_FREE:
+		printf("token %u", r->arg);
+		break;
+	case TRACE_SET_REG:
+		printf("%c = %s", r->arg & 0xFF, typeName(r->arg >> 8));
+		break;
+	}
+	printf("\n");
+}
+
+/**
+ * \brief Read monitor output containing 'trace dump's and print each
+ * one's records as a timeline, microseconds from the first record and from the
+ * one before. A command's number is its line in 'help', from 0.
+ * \param argc  Argument count
+ * \param argv  Optional file name, standard input if none
+ */
+int main(int argc, char* argv[])
+{
+	FILE* f = stdin;
+	char line[256];
+	bool found = false;
+	unsigned n = 0;
+	uint32_t t0 = 0, prev = 0;
+
+	if ((argc > 1) && ((f = fopen(argv[1], "r")) == NULL)) {
+		perror(argv[1]);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		unsigned sent, written;
+		if (sscanf(line, "trace %u of %u", &sent, &written) == 2) {
+			// each dump has its own timeline
+			found = true;
+			n = 0;
+			printf("%u records of %u written\n", sent, written);
+			continue;
+		}
+		if (!found || (line[0] != 't'))
+			continue;
+		for (char* p = &line[1]; strspn(p, "0123456789ABCDEFabcdef") >= 14; p += 14) {
+			traceRec_t r;
+			r.id = hex(p, 2);
+			r.arg = hex(p + 2, 4);
+			r.time = hex(p + 6, 8);
+			if (n++ == 0)
+				t0 = prev = r.time;
+			print(&r, t0, prev);
+			prev = r.time;
+		}
+	}
+	if (!found) {
+		fprintf(stderr, "no trace dump found\n");
+		return 1;
+	}
+	return 0;
+}
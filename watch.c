@@ -0,0 +1,168 @@
+/**
+ * \file watch.c
+ * \brief Periodically repeat a command.
+ * \author    Alan Backlund
+ * \version   1.0
+ * \date      2015 Jul 29
+ * \copyright 2015 Alan Backlund
+ * \section License The MIT License (MIT)
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "watch.h"
+#include "context.h"
+#include "timer.h"
+#include "process.h"
+#include "print.h"
+#include "emit.h"
+#include "text.h"
+#include "main.h"
+
+/**
+ * \brief A watched command
+ */
+typedef struct {
+	int timer;  //!< Timer handle, 0 if the watch is unused
+	mon_ctx_t* ctx;  //!< Session that started the watch
+	int numTokens;  //!< Number of tokens in command
+	token_t tokens[WATCH_ARGS];  //!< Command, lexed once when the watch starts
+	char last[MAX_STRING];  //!< Last result displayed
+} watch_t;
+
+static watch_t watches[MAX_WATCHES];
+
+/**
+ * \brief Timer expiry function, re-run a watched command and display
+ * its result if it has changed.
+ * \param arg  The watch
+ */
+static void watchTick(void* arg)
+{
+	watch_t* w = arg;
+	mon_ctx_t* ctx = w->ctx;
+	token_t* src[WATCH_ARGS];
+
+	for (int i=0; i<w->numTokens; i++)
+		src[i] = &w->tokens[i];
+	token_t* r = evalTokens(ctx, src, w->numTokens);
+	if (r == NULL)
+		return;
+	char buf[FORMAT_LEN];
+	char *s = "";
+	if ((r->t != EMPTY) && (r->t != ERR))
+		s = tokenGetText(ctx, r, buf);
+	if (strcmp(s, w->last)) {
+		strncpy(w->last, s, MAX_STRING-1);
+		emitDec(ctx, w - watches + 1, 0);
+		emitString(ctx, ": ");
+		emitStr(ctx, w->last, strlen(w->last));
+		emitString(ctx, EOL);
+	}
+	tokenFree(ctx, r);
+}
+
+/**
+ * \brief Start repeating a command
+ * \param args  Array of 'NUM' period in milliseconds and the command
+ * \param nArgs  Number of arguments, must be two
+ * \returns 'NUM' token containing the watch number (must be freed)
+ */
+token_t* cmd_watch(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	token_t* tokens[MAX_ARGS];
+	watch_t* w = NULL;
+	token_t* r = tokenAlloc(ctx, "cmd_watch");
+
+	for (int i=0; i<MAX_WATCHES; i++)
+		if (watches[i].timer == 0) {
+			w = &watches[i];
+			break;
+		}
+	char buf[FORMAT_LEN];
+	int numTokens = tokenize(ctx, tokenGetText(ctx, args[1], buf), tokens, 0);
+	bool ok = (w != NULL) && (args[0]->v.d > 0)
+		&& (numTokens > 0) && (numTokens <= WATCH_ARGS);
+	for (int i=0; i<numTokens; i++) {
+		if (tokens[i]->t == ERR)
+			ok = false;
+#ifdef INCL_EXIT
+		if (tokens[i]->t == EXIT)
+			ok = false;
+#endif
+		if (ok)
+			memcpy(&w->tokens[i], tokens[i], sizeof(token_t));
+		tokenFree(ctx, tokens[i]);
+	}
+	if (ok) {
+		w->ctx = ctx;
+		w->numTokens = numTokens;
+		w->last[0] = 0;
+		w->timer = timerStart((args[0]->v.d + TIMER_TICK_MS - 1) / TIMER_TICK_MS,
+							  watchTick, w);
+		ok = (w->timer > 0);
+		if (!ok)
+			w->timer = 0;
+	}
+	if (ok) {
+		r->t = NUM;
+		r->v.d = w - watches + 1;
+	} else {
+		emitError(ctx, r, MSG_WATCH);
+	}
+	return r;
+}
+
+/**
+ * \brief Stop repeating a command
+ * \param args  Array of single argument, the 'NUM' watch number
+ * \param nArgs  Number of arguments, must be one
+ * \returns EMPTY token (must be freed)
+ */
+token_t* cmd_unwatch(mon_ctx_t* ctx, token_t *args[], int nArgs)
+{
+	int n = args[0]->v.d - 1;
+	token_t* r = tokenAlloc(ctx, "cmd_unwatch");
+
+	if ((n >= 0) && (n < MAX_WATCHES) && (watches[n].timer != 0)
+		&& (watches[n].ctx == ctx)) {
+		timerCancel(watches[n].timer);
+		watches[n].timer = 0;
+		r->t = EMPTY;
+	} else {
+		emitError(ctx, r, MSG_NO_WATCH);
+	}
+	return r;
+}
+
+/**
+ * \brief Stop all the watches a session started, e.g. when it closes
+ * \param ctx  The session's context
+ */
+void watchStop(mon_ctx_t* ctx)
+{
+	for (int i=0; i<MAX_WATCHES; i++) {
+		if ((watches[i].timer != 0) && (watches[i].ctx == ctx)) {
+			timerCancel(watches[i].timer);
+			watches[i].timer = 0;
+		}
+	}
+}